@@ -0,0 +1,48 @@
+#include "Benchmark.hpp"
+#include <Lua/Allocator.hpp>
+
+static const size_t Iterations = 20;
+
+static const char churn_script[] =
+	"local t = {} "
+	"for i = 1, 100000 do "
+	"	t[i % 1000 + 1] = { i, tostring( i ), x = i } "
+	"end";
+
+static void Churn( const char *name, Lua::Interface &lua )
+{
+	Benchmark::Measure( name, Iterations, [&lua]( )
+	{
+		lua.RunString( churn_script );
+	} );
+}
+
+BENCHMARK( Allocator )
+{
+	{
+		Lua::Interface lua;
+		Churn( "table churn (default allocator)", lua );
+	}
+
+	{
+		Lua::PoolAllocator allocator;
+		Lua::Interface lua( allocator );
+		Churn( "table churn (pool allocator)", lua );
+	}
+
+	{
+		Lua::LimitedAllocator allocator( 256 * 1024 * 1024 );
+		Lua::Interface lua( allocator );
+		Churn( "table churn (limited allocator)", lua );
+	}
+
+	{
+		Lua::ArenaAllocator allocator;
+		{
+			Lua::Interface lua( allocator );
+			Churn( "table churn (arena allocator)", lua );
+		}
+
+		allocator.Reset( );
+	}
+}
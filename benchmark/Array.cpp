@@ -0,0 +1,55 @@
+#include "Benchmark.hpp"
+#include <vector>
+
+static const size_t Iterations = 100;
+
+static const int Elements = 100000;
+
+BENCHMARK( Array )
+{
+	Lua::Interface lua;
+	lua.LoadString( "local t = { } for i = 1, 100000 do t[i] = i * 0.5 end return t" );
+	lua.PCall( 0, 1 );
+
+	std::vector<double> values( Elements );
+	Benchmark::Measure( "RawGetI + ToNumber (100k elements)", Iterations, [&lua, &values]( )
+	{
+		for( int k = 0; k < Elements; ++k )
+		{
+			lua.RawGetI( -1, k + 1 );
+			values[k] = lua.ToNumber( -1 );
+			lua.Pop( 1 );
+		}
+	} );
+
+	Benchmark::Measure( "ReadArray<double> (100k elements)", Iterations, [&lua, &values]( )
+	{
+		lua.ReadArray( -1, values );
+	} );
+
+	std::vector<float> floats;
+	Benchmark::Measure( "ReadArray<float> (100k elements)", Iterations, [&lua, &floats]( )
+	{
+		lua.ReadArray( -1, floats );
+	} );
+
+	lua.Pop( 1 );
+
+	Benchmark::Measure( "CreateTable + PushNumber + RawSetI (100k elements)", Iterations, [&lua, &values]( )
+	{
+		lua.CreateTable( Elements, 0 );
+		for( int k = 0; k < Elements; ++k )
+		{
+			lua.PushNumber( values[k] );
+			lua.RawSetI( -2, k + 1 );
+		}
+
+		lua.Pop( 1 );
+	} );
+
+	Benchmark::Measure( "PushArray<double> (100k elements)", Iterations, [&lua, &values]( )
+	{
+		lua.PushArray( values );
+		lua.Pop( 1 );
+	} );
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Lua/Interface.hpp>
+#include <stddef.h>
+#include <stdio.h>
+#include <chrono>
+
+namespace Benchmark
+{
+
+typedef void ( *Function )( );
+
+class Registrar
+{
+public:
+	Registrar( const char *name, Function func );
+
+	static size_t Run( const char *filter );
+
+private:
+	const char *name;
+	Function function;
+	Registrar *next;
+};
+
+template<typename Callable> double Measure( const char *name, size_t iterations, Callable callable )
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	clock::time_point start = clock::now( );
+	for( size_t k = 0; k < iterations; ++k )
+		callable( );
+
+	double elapsed = std::chrono::duration<double, std::nano>( clock::now( ) - start ).count( );
+	double per_iteration = elapsed / static_cast<double>( iterations );
+	printf( "%-48s %12.2f ns/op\n", name, per_iteration );
+	return per_iteration;
+}
+
+}
+
+#define BENCHMARK( name )															\
+	static void benchmark_ ## name( );												\
+	static Benchmark::Registrar registrar_ ## name( #name, benchmark_ ## name );	\
+	static void benchmark_ ## name( )
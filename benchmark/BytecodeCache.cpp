@@ -0,0 +1,69 @@
+#include "Benchmark.hpp"
+#include <Lua/BytecodeCache.hpp>
+#include <vector>
+
+static const size_t Iterations = 200;
+
+static const char script_path[] = "benchmark_bytecodecache.lua";
+
+static bool WriteScript( )
+{
+	FILE *file = fopen( script_path, "wb" );
+	if( file == nullptr )
+		return false;
+
+	// Roughly 4000 lines of functions, to make parsing dominate
+	for( int k = 0; k < 1000; ++k )
+		fprintf( file,
+			"function f%d( a, b )\n"
+			"\tlocal t = { a, b, x = a * %d, y = tostring( b ) .. \"%d\" }\n"
+			"\treturn t.x + #t.y\n"
+			"end\n", k, k, k );
+
+	return fclose( file ) == 0;
+}
+
+BENCHMARK( BytecodeCache )
+{
+	if( !WriteScript( ) )
+		return;
+
+	Lua::Interface lua;
+
+	Benchmark::Measure( "LoadFile (parser)", Iterations, [&lua]( )
+	{
+		lua.LoadFile( script_path );
+		lua.Pop( 1 );
+	} );
+
+	Lua::BytecodeCache cache;
+	lua.SetBytecodeCache( &cache );
+
+	Benchmark::Measure( "LoadFile (bytecode cache)", Iterations, [&lua]( )
+	{
+		lua.LoadFile( script_path );
+		lua.Pop( 1 );
+	} );
+
+	// Keep one loaded chunk on the stack for the Dump benchmarks
+	lua.LoadFile( script_path );
+
+	lua.SetBytecodeCache( nullptr );
+	remove( script_path );
+
+	Benchmark::Measure( "Dump (Lua string)", Iterations, [&lua]( )
+	{
+		size_t length = 0;
+		lua.Dump( &length );
+		lua.Pop( 1 );
+	} );
+
+	std::vector<uint8_t> output;
+	Benchmark::Measure( "Dump (reused std::vector)", Iterations, [&lua, &output]( )
+	{
+		output.clear( );
+		lua.Dump( output );
+	} );
+
+	lua.Pop( 1 );
+}
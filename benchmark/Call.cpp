@@ -0,0 +1,35 @@
+#include "Benchmark.hpp"
+
+static const size_t Iterations = 2000000;
+
+BENCHMARK( Call )
+{
+	Lua::Interface lua;
+	lua.RunString( "function add( a, b ) return a + b end" );
+	lua.PushGlobal( );
+
+	Benchmark::Measure( "Push + Call + ToInteger + Pop", Iterations, [&lua]( )
+	{
+		lua.GetField( -1, "add" );
+		lua.PushInteger( 1 );
+		lua.PushInteger( 2 );
+		lua.Call( 2, 1 );
+		lua.ToInteger( -1 );
+		lua.Pop( 1 );
+	} );
+
+	Benchmark::Measure( "SCall<long long>", Iterations, [&lua]( )
+	{
+		lua.GetField( -1, "add" );
+		lua.SCall<long long>( 1, 2 );
+	} );
+
+	std::tuple<long long> result;
+	Benchmark::Measure( "SPCall<long long>", Iterations, [&lua, &result]( )
+	{
+		lua.GetField( -1, "add" );
+		lua.SPCall( result, 1, 2 );
+	} );
+
+	lua.Pop( 1 );
+}
@@ -0,0 +1,91 @@
+#include "Benchmark.hpp"
+#include <Lua/Class.hpp>
+
+static const size_t Iterations = 20;
+
+static const Lua::TypeTag counter_type( "counter" );
+
+static const char call_script[] =
+	"local c = counter( ) "
+	"for i = 1, 100000 do "
+	"	c:add( 1 ) "
+	"end";
+
+class Counter
+{
+public:
+	Counter( ) :
+		value( 0 )
+	{ }
+
+	long long Add( long long amount )
+	{
+		value += amount;
+		return value;
+	}
+
+private:
+	long long value;
+};
+
+static int create( lua_State *state )
+{
+	Lua::Class<Counter>::New( GetLuaInterface( state ) );
+	return 1;
+}
+
+// Hand-written equivalents of the generated trampoline
+static int add_by_name( lua_State *state )
+{
+	Lua::Interface &lua = GetLuaInterface( state );
+	Counter *counter = static_cast<Counter *>( lua.CheckUserdata( 1, counter_type.GetName( ) ) );
+	lua.PushInteger( counter->Add( lua.CheckInteger( 2 ) ) );
+	return 1;
+}
+
+static int add_by_tag( lua_State *state )
+{
+	Lua::Interface &lua = GetLuaInterface( state );
+	Counter *counter = lua.CheckUserdata<Counter>( 1, counter_type );
+	lua.PushInteger( counter->Add( lua.CheckInteger( 2 ) ) );
+	return 1;
+}
+
+BENCHMARK( Class )
+{
+	Lua::Interface lua;
+
+	{
+		Lua::Class<Counter> counter( lua, counter_type );
+		counter.Method( "add", add_by_name );
+		lua.PushGlobal( );
+		counter.PushFunction( create );
+		lua.SetField( -2, counter_type.GetName( ) );
+		lua.Pop( 1 );
+	}
+
+	Benchmark::Measure( "100k method calls (CheckUserdata by name)", Iterations, [&lua]( )
+	{
+		lua.RunString( call_script );
+	} );
+
+	{
+		Lua::Class<Counter> counter( lua, counter_type );
+		counter.Method( "add", add_by_tag );
+	}
+
+	Benchmark::Measure( "100k method calls (CheckUserdata by tag)", Iterations, [&lua]( )
+	{
+		lua.RunString( call_script );
+	} );
+
+	{
+		Lua::Class<Counter> counter( lua, counter_type );
+		counter.Method( "add", LUAINTERFACE_METHOD( Counter::Add ) );
+	}
+
+	Benchmark::Measure( "100k method calls (LUAINTERFACE_METHOD)", Iterations, [&lua]( )
+	{
+		lua.RunString( call_script );
+	} );
+}
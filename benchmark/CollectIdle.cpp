@@ -0,0 +1,76 @@
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <vector>
+
+static const size_t Requests = 5000;
+
+static const std::chrono::microseconds IdleBudget( 200 );
+
+// Keeps a few thousand live objects around, like a cache, and makes garbage on every request
+static const char bootstrap_script[] =
+	"cache = { }\n"
+	"for i = 1, 5000 do cache[i] = { id = i, name = 'entry ' .. i } end\n"
+	"function handle( n )\n"
+	"\tlocal rows = { }\n"
+	"\tfor i = 1, 200 do rows[i] = { n, tostring( n + i ) } end\n"
+	"\tcache[n % #cache + 1] = { id = n, name = rows[1][2] }\n"
+	"\treturn #rows\n"
+	"end\n";
+
+static void Report( const char *name, std::vector<double> &latencies )
+{
+	std::sort( latencies.begin( ), latencies.end( ) );
+	printf(
+		"%-48s p50 %8.2f us, p99 %8.2f us, max %8.2f us\n",
+		name,
+		latencies[latencies.size( ) / 2],
+		latencies[latencies.size( ) * 99 / 100],
+		latencies.back( )
+	);
+}
+
+static void Serve( const char *name, bool idle_collection )
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	Lua::Interface lua;
+	lua.RunString( bootstrap_script );
+	lua.GarbageCollect( Lua::GC::Collect );
+	lua.PushGlobal( );
+	lua.GetField( -1, "handle" );
+	int handle = lua.GetTop( );
+
+	std::vector<double> latencies;
+	latencies.reserve( Requests );
+	size_t idle_steps = 0;
+	for( size_t k = 0; k < Requests; ++k )
+	{
+		clock::time_point start = clock::now( );
+		lua.PushValue( handle );
+		lua.PushNumber( static_cast<double>( k ) );
+		lua.PCall( 1, 0 );
+		latencies.push_back( std::chrono::duration<double, std::micro>( clock::now( ) - start ).count( ) );
+
+		if( idle_collection )
+			idle_steps += lua.CollectIdle( IdleBudget ).steps;
+	}
+
+	lua.Pop( 2 );
+	Report( name, latencies );
+	if( idle_collection )
+		printf( "%-48s %llu steps\n", "idle collection", static_cast<unsigned long long>( idle_steps ) );
+}
+
+BENCHMARK( CollectIdle )
+{
+	Serve( "request latency", false );
+	Serve( "request latency (CollectIdle between requests)", true );
+
+	Lua::Interface lua;
+	lua.RunString( bootstrap_script );
+	lua.RunString( "cache = nil" );
+	Benchmark::Measure( "CollectFor 100 us", 100, [&lua]( )
+	{
+		lua.CollectFor( std::chrono::microseconds( 100 ) );
+	} );
+}
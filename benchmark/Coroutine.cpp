@@ -0,0 +1,39 @@
+#include "Benchmark.hpp"
+
+static const size_t Iterations = 1000000;
+
+static const char spawn_script[] =
+	"local create, resume, noop = coroutine.create, coroutine.resume, ... "
+	"local function body( ) end "
+	"local function body_native( ) noop( ) end "
+	"return function( ) resume( create( body ) ) end, "
+	"	function( ) resume( create( body_native ) ) end";
+
+static int Noop( lua_State *state )
+{
+	GetLuaInterface( state );
+	return 0;
+}
+
+BENCHMARK( Coroutine )
+{
+	Lua::Interface lua;
+
+	lua.LoadString( spawn_script );
+	lua.PushFunction( Noop );
+	lua.Call( 1, 2 );
+
+	Benchmark::Measure( "coroutine spawn (Lua body)", Iterations, [&lua]( )
+	{
+		lua.PushValue( -2 );
+		lua.Call( );
+	} );
+
+	Benchmark::Measure( "coroutine spawn (body calls C function)", Iterations, [&lua]( )
+	{
+		lua.PushValue( -1 );
+		lua.Call( );
+	} );
+
+	lua.Pop( 2 );
+}
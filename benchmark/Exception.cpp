@@ -0,0 +1,58 @@
+#include "Benchmark.hpp"
+#include <stdexcept>
+
+static const size_t Iterations = 1000000;
+
+static const size_t ErrorIterations = 100000;
+
+static int Succeed( lua_State * )
+{
+	return 0;
+}
+
+// What a per-call wrapper like SafeLuaFunction adds to every call
+static int SucceedWrapped( lua_State *state )
+{
+	Lua::Interface &lua = GetLuaInterface( state );
+
+	try
+	{
+		return Succeed( state );
+	}
+	catch( std::exception &e )
+	{
+		lua.PushString( e.what( ) );
+	}
+
+	return lua.Error( );
+}
+
+static int RaiseLuaError( lua_State *state )
+{
+	return GetLuaInterface( state ).ThrowError( "failure" );
+}
+
+static int ThrowException( lua_State * )
+{
+	throw std::runtime_error( "failure" );
+}
+
+static void Run( Lua::Interface &lua, const char *name, size_t iterations, Lua::Function function )
+{
+	Benchmark::Measure( name, iterations, [&lua, function]( )
+	{
+		lua.PushFunction( function );
+		if( lua.PCall( ) != 0 )
+			lua.Pop( 1 );
+	} );
+}
+
+BENCHMARK( Exception )
+{
+	Lua::Interface lua;
+
+	Run( lua, "PCall", Iterations, Succeed );
+	Run( lua, "PCall (per-call try/catch wrapper)", Iterations, SucceedWrapped );
+	Run( lua, "PCall raising a Lua error", ErrorIterations, RaiseLuaError );
+	Run( lua, "PCall throwing a C++ exception", ErrorIterations, ThrowException );
+}
@@ -0,0 +1,111 @@
+#include "Benchmark.hpp"
+#include <Lua/Message.hpp>
+#include <lua.hpp>
+
+static const size_t Iterations = 1000;
+
+static const char payload_script[] =
+	"local items = { }\n"
+	"for i = 1, 200 do\n"
+	"\titems[i] = { id = i, name = 'item', price = i * 1.25, tags = { 'red', 'blue' }, active = i % 2 == 0 }\n"
+	"end\n"
+	"local payload = { kind = 'update', items = items }\n"
+	"payload.self = payload\n"
+	"return payload\n";
+
+// Recursive copy between two states through their stacks, with a cache
+// for tables already copied, like lanes does with luaG_inter_copy
+static void InterCopy( lua_State *from, int index, lua_State *to, int cache )
+{
+	switch( lua_type( from, index ) )
+	{
+		case LUA_TBOOLEAN:
+			lua_pushboolean( to, lua_toboolean( from, index ) );
+			break;
+
+		case LUA_TNUMBER:
+
+#if LUA_VERSION_NUM >= 503
+
+			if( lua_isinteger( from, index ) )
+			{
+				lua_pushinteger( to, lua_tointeger( from, index ) );
+				break;
+			}
+
+#endif
+
+			lua_pushnumber( to, lua_tonumber( from, index ) );
+			break;
+
+		case LUA_TSTRING:
+		{
+			size_t len = 0;
+			const char *data = lua_tolstring( from, index, &len );
+			lua_pushlstring( to, data, len );
+			break;
+		}
+
+		case LUA_TTABLE:
+		{
+			const void *pointer = lua_topointer( from, index );
+			lua_pushlightuserdata( to, const_cast<void *>( pointer ) );
+			lua_rawget( to, cache );
+			if( !lua_isnil( to, -1 ) )
+				break;
+
+			lua_pop( to, 1 );
+			lua_newtable( to );
+			lua_pushlightuserdata( to, const_cast<void *>( pointer ) );
+			lua_pushvalue( to, -2 );
+			lua_rawset( to, cache );
+
+			lua_pushnil( from );
+			while( lua_next( from, index ) != 0 )
+			{
+				int top = lua_gettop( from );
+				InterCopy( from, top - 1, to, cache );
+				InterCopy( from, top, to, cache );
+				lua_rawset( to, -3 );
+				lua_pop( from, 1 );
+			}
+
+			break;
+		}
+
+		default:
+			lua_pushnil( to );
+			break;
+	}
+}
+
+BENCHMARK( Message )
+{
+	Lua::Interface source, destination;
+	source.LoadString( payload_script );
+	source.PCall( 0, 1 );
+
+	lua_State *from = source.GetLuaState( );
+	lua_State *to = destination.GetLuaState( );
+	Benchmark::Measure( "direct copy between states (inter-copy)", Iterations, [from, to]( )
+	{
+		lua_newtable( to );
+		InterCopy( from, lua_gettop( from ), to, lua_gettop( to ) );
+		lua_pop( to, 2 );
+	} );
+
+	Lua::Message message;
+	Benchmark::Measure( "Message::Encode", Iterations, [&source, &message]( )
+	{
+		message.Encode( source, -1 );
+	} );
+
+	Benchmark::Measure( "Message::Decode", Iterations, [&destination, &message]( )
+	{
+		message.Decode( destination );
+		destination.Pop( 1 );
+	} );
+
+	printf( "message size: %llu bytes\n", static_cast<unsigned long long>( message.GetSize( ) ) );
+	source.Pop( 1 );
+}
@@ -0,0 +1,62 @@
+#include "Benchmark.hpp"
+#include <atomic>
+#include <thread>
+
+static const size_t Iterations = 20;
+
+static const char workload[] =
+	"local t = { }\n"
+	"for i = 1, 20000 do t[i] = { i, tostring( i ) } end\n"
+	"return #t\n";
+
+BENCHMARK( Metrics )
+{
+	Lua::Interface lua;
+	lua.LoadString( workload );
+	int chunk = lua.GetTop( );
+
+	Benchmark::Measure( "allocation heavy workload", Iterations, [&lua, chunk]( )
+	{
+		lua.PushValue( chunk );
+		lua.PCall( 0, 1 );
+		lua.Pop( 1 );
+	} );
+
+	// Snapshots taken from another thread while the state runs don't slow it down
+	std::atomic<bool> running( true );
+	std::thread reader( [&lua, &running]( )
+	{
+		while( running )
+		{
+			lua.GetMetrics( );
+			std::this_thread::yield( );
+		}
+	} );
+
+	Benchmark::Measure( "allocation heavy workload (snapshots from another thread)", Iterations, [&lua, chunk]( )
+	{
+		lua.PushValue( chunk );
+		lua.PCall( 0, 1 );
+		lua.Pop( 1 );
+	} );
+
+	running = false;
+	reader.join( );
+
+	Benchmark::Measure( "GetMetrics", 100000, [&lua]( )
+	{
+		lua.GetMetrics( );
+	} );
+
+	Lua::Metrics metrics = lua.GetMetrics( );
+	printf(
+		"allocated %llu bytes, freed %llu bytes, %llu GC cycles in %.2f ms, %llu pcalls, %llu errors, peak stack %llu slots\n",
+		static_cast<unsigned long long>( metrics.bytes_allocated ),
+		static_cast<unsigned long long>( metrics.bytes_freed ),
+		static_cast<unsigned long long>( metrics.gc_cycles ),
+		metrics.gc_time / 1000000.0,
+		static_cast<unsigned long long>( metrics.pcalls ),
+		static_cast<unsigned long long>( metrics.errors ),
+		static_cast<unsigned long long>( metrics.peak_stack )
+	);
+}
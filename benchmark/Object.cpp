@@ -0,0 +1,38 @@
+#include "Benchmark.hpp"
+
+static const size_t Iterations = 2000000;
+
+static void ObjectBenchmarks( Lua::Interface &lua, const char *create, const char *copy, const char *push )
+{
+	lua.CreateTable( );
+
+	Benchmark::Measure( create, Iterations, [&lua]( )
+	{
+		Lua::Object obj = lua.ToObject( -1 );
+	} );
+
+	Lua::Object obj = lua.ToObject( -1 );
+	Benchmark::Measure( copy, Iterations, [&obj]( )
+	{
+		Lua::Object copy = obj;
+	} );
+
+	Benchmark::Measure( push, Iterations, [&lua, &obj]( )
+	{
+		lua.PushObject( obj );
+		lua.Pop( 1 );
+	} );
+
+	obj.Release( );
+	lua.Pop( 1 );
+	lua.FlushReferences( );
+}
+
+BENCHMARK( Object )
+{
+	Lua::Interface lua;
+	ObjectBenchmarks( lua, "ToObject + destroy (registry)", "Object copy + destroy (registry)", "PushObject + Pop (registry)" );
+
+	lua.SetReferenceTable( true );
+	ObjectBenchmarks( lua, "ToObject + destroy (table)", "Object copy + destroy (table)", "PushObject + Pop (table)" );
+}
@@ -0,0 +1,50 @@
+#include "Benchmark.hpp"
+#include <algorithm>
+
+static const size_t Iterations = 10;
+
+static const size_t Rounds = 10;
+
+static const char workload[] =
+	"local function fib( n ) if n < 2 then return n end return fib( n - 1 ) + fib( n - 2 ) end\n"
+	"return fib( 24 )\n";
+
+BENCHMARK( Profiler )
+{
+	Lua::Interface lua;
+	lua.LoadString( workload );
+	int chunk = lua.GetTop( );
+
+	auto run = [&lua, chunk]( )
+	{
+		lua.PushValue( chunk );
+		lua.PCall( );
+	};
+
+	// Rounds are interleaved and the best one is kept, to filter out noise from other processes
+	double base = 0.0, profiled = 0.0;
+	for( size_t k = 0; k < Rounds; ++k )
+	{
+		double time = Benchmark::Measure( "workload", Iterations, run );
+		base = k == 0 ? time : std::min( base, time );
+
+		lua.StartProfiler( 1000 );
+		time = Benchmark::Measure( "workload (profiler at 1 kHz)", Iterations, run );
+		profiled = k == 0 ? time : std::min( profiled, time );
+		lua.StopProfiler( );
+	}
+
+	lua.Pop( 1 );
+
+	lua.PushProfile( );
+	size_t stacks = 0;
+	lua.PushNil( );
+	while( lua.Next( -2 ) != 0 )
+	{
+		++stacks;
+		lua.Pop( 1 );
+	}
+
+	lua.Pop( 1 );
+	printf( "profiler overhead: %.2f%% (%llu distinct stacks)\n", ( profiled / base - 1.0 ) * 100.0, static_cast<unsigned long long>( stacks ) );
+}
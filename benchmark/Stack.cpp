@@ -0,0 +1,52 @@
+#include "Benchmark.hpp"
+
+static const size_t Iterations = 10000000;
+
+BENCHMARK( Stack )
+{
+	Lua::Interface lua;
+
+	Benchmark::Measure( "PushNumber + Pop", Iterations, [&lua]( )
+	{
+		lua.PushNumber( 1.0 );
+		lua.Pop( 1 );
+	} );
+
+	Benchmark::Measure( "PushInteger + ToInteger + Pop", Iterations, [&lua]( )
+	{
+		lua.PushInteger( 1 );
+		lua.ToInteger( -1 );
+		lua.Pop( 1 );
+	} );
+
+	Benchmark::Measure( "PushNumber + GetType + ToNumber + Pop", Iterations, [&lua]( )
+	{
+		lua.PushNumber( 1.0 );
+		if( lua.GetType( -1 ) == Lua::Type::Number )
+			lua.ToNumber( -1 );
+
+		lua.Pop( 1 );
+	} );
+
+	Benchmark::Measure( "GetTop", Iterations, [&lua]( )
+	{
+		lua.GetTop( );
+	} );
+
+	lua.CreateTable( 64, 0 );
+	for( int k = 1; k <= 64; ++k )
+	{
+		lua.PushNumber( k );
+		lua.RawSetI( -2, k );
+	}
+
+	int index = 0;
+	Benchmark::Measure( "RawGetI + ToNumber + Pop", Iterations, [&lua, &index]( )
+	{
+		lua.RawGetI( -1, ( index++ & 63 ) + 1 );
+		lua.ToNumber( -1 );
+		lua.Pop( 1 );
+	} );
+
+	lua.Pop( 1 );
+}
@@ -0,0 +1,32 @@
+#include "Benchmark.hpp"
+
+static const size_t Iterations = 2000;
+
+BENCHMARK( Startup )
+{
+	Benchmark::Measure( "Interface (all libraries)", Iterations, [ ]( )
+	{
+		Lua::Interface lua;
+	} );
+
+	Benchmark::Measure( "Interface (base only)", Iterations, [ ]( )
+	{
+		Lua::Interface lua( Lua::Library::Base );
+	} );
+
+	Benchmark::Measure( "Interface (base, string, table, math)", Iterations, [ ]( )
+	{
+		Lua::Interface lua( Lua::Library::Base | Lua::Library::String | Lua::Library::Table | Lua::Library::Math );
+	} );
+
+	Benchmark::Measure( "Interface (base, package, rest lazy)", Iterations, [ ]( )
+	{
+		Lua::Interface lua( Lua::Library::Base | Lua::Library::Package, Lua::Library::All );
+	} );
+
+	Benchmark::Measure( "Interface (lazy) + string access", Iterations, [ ]( )
+	{
+		Lua::Interface lua( Lua::Library::Base | Lua::Library::Package, Lua::Library::All );
+		lua.RunString( "return string.format( '%d', 1 )" );
+	} );
+}
@@ -0,0 +1,63 @@
+#include "Benchmark.hpp"
+#include <Lua/StatePool.hpp>
+#include <thread>
+#include <vector>
+
+static const size_t Iterations = 2000;
+
+static const char bootstrap_script[] =
+	"config = { name = 'service', retries = 3 }\n"
+	"function handle( request )\n"
+	"\treturn request .. ' handled by ' .. config.name\n"
+	"end\n";
+
+static void Bootstrap( Lua::Interface &lua )
+{
+	lua.RunString( bootstrap_script );
+}
+
+static void Request( Lua::Interface &lua )
+{
+	lua.RunString( "leaked = {} string.custom = true return handle( 'request' )" );
+}
+
+BENCHMARK( StatePool )
+{
+	Benchmark::Measure( "fresh Interface + bootstrap", Iterations, [ ]( )
+	{
+		Lua::Interface lua;
+		Bootstrap( lua );
+		Request( lua );
+	} );
+
+	Lua::StatePool pool( 1, Bootstrap );
+
+	Benchmark::Measure( "StatePool Acquire + restore", Iterations, [&pool]( )
+	{
+		Lua::StatePool::Handle handle = pool.Acquire( );
+		Request( *handle );
+	} );
+
+	unsigned int thread_count = std::thread::hardware_concurrency( );
+	if( thread_count < 2 )
+		return;
+
+	Lua::StatePool shared( thread_count, Bootstrap );
+
+	Benchmark::Measure( "StatePool Acquire + restore (all threads, total)", 1, [&shared, thread_count]( )
+	{
+		std::vector<std::thread> threads;
+		for( unsigned int k = 0; k < thread_count; ++k )
+			threads.push_back( std::thread( [&shared]( )
+			{
+				for( size_t i = 0; i < Iterations; ++i )
+				{
+					Lua::StatePool::Handle handle = shared.Acquire( );
+					Request( *handle );
+				}
+			} ) );
+
+		for( size_t k = 0; k < threads.size( ); ++k )
+			threads[k].join( );
+	} );
+}
@@ -0,0 +1,33 @@
+#include "Benchmark.hpp"
+#include <vector>
+
+static const size_t Iterations = 200;
+
+static const size_t PayloadSize = 4 * 1024 * 1024;
+
+BENCHMARK( StringView )
+{
+	std::vector<char> payload( PayloadSize );
+	for( size_t k = 0; k < payload.size( ); ++k )
+		payload[k] = static_cast<char>( k * 31 );
+
+	Lua::Interface lua;
+
+	Benchmark::Measure( "PushString (4 MB)", Iterations, [&lua, &payload]( )
+	{
+		// Touch the payload so every push makes a new string
+		++payload[0];
+		lua.PushString( payload.data( ), payload.size( ) );
+		lua.Pop( 1 );
+	} );
+
+	lua.GarbageCollect( Lua::GC::Collect );
+
+	Benchmark::Measure( "PushStringView (4 MB)", Iterations, [&lua, &payload]( )
+	{
+		lua.PushStringView( payload.data( ), payload.size( ) );
+		lua.Pop( 1 );
+	} );
+
+	lua.GarbageCollect( Lua::GC::Collect );
+}
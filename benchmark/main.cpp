@@ -0,0 +1,49 @@
+#include "Benchmark.hpp"
+#include <string.h>
+
+namespace Benchmark
+{
+
+static Registrar *registrars = nullptr;
+
+Registrar::Registrar( const char *name, Function func ) :
+	name( name ),
+	function( func ),
+	next( registrars )
+{
+	registrars = this;
+}
+
+size_t Registrar::Run( const char *filter )
+{
+	size_t ran = 0;
+	for( Registrar *registrar = registrars; registrar != nullptr; registrar = registrar->next )
+	{
+		if( filter != nullptr && strstr( registrar->name, filter ) == nullptr )
+			continue;
+
+		printf( "[%s]\n", registrar->name );
+		registrar->function( );
+		++ran;
+	}
+
+	return ran;
+}
+
+}
+
+#if defined LUAINTERFACE_INLINE
+
+static const char interface_mode[] = "inline";
+
+#else
+
+static const char interface_mode[] = "exported";
+
+#endif
+
+int main( int argc, char **argv )
+{
+	printf( "%s (%s interface)\n", Lua::Interface::Version( ), interface_mode );
+	return Benchmark::Registrar::Run( argc < 2 ? nullptr : argv[1] ) != 0 ? 0 : -1;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+#include <stddef.h>
+#include <vector>
+
+namespace Lua
+{
+
+/*!
+ \brief Base class for memory allocators used by Lua states.
+ \details An allocator must outlive every Interface created with it.
+ Allocators are not thread-safe, each one is meant to serve a single
+ Lua state (and its threads).
+ */
+class LUAINTERFACE_API Allocator
+{
+public:
+	/*!
+	 \brief Destructor.
+	 */
+	virtual ~Allocator( );
+
+	/*!
+	 \brief Allocates, reallocates or frees a block of memory.
+	 \details Follows the same contract as lua_Alloc: when newsize
+	 is 0, ptr must be freed and nullptr returned. Otherwise, ptr (which
+	 may be nullptr) must be resized to newsize bytes and the new block
+	 returned, or nullptr if the request can't be fulfilled, in which
+	 case ptr must be left untouched. Shrinking a block must never fail.
+	 Must not throw.
+	 \param ptr block being reallocated or freed, or nullptr
+	 \param oldsize current size of the block (0 when ptr is nullptr)
+	 \param newsize requested size of the block
+	 \return the new block, or nullptr if freed or on failure
+	 */
+	virtual void *Reallocate( void *ptr, size_t oldsize, size_t newsize ) = 0;
+};
+
+/*!
+ \brief Allocator with segregated free lists for small blocks.
+ \details Blocks up to MaxBlockSize bytes are rounded up to a
+ multiple of Granularity and served from per-size-class free lists,
+ carved out of large slabs. Bigger blocks go straight to the C runtime.
+ Memory returned to a free list is only given back to the system when
+ the allocator is destroyed.
+ */
+class LUAINTERFACE_API PoolAllocator : public Allocator
+{
+public:
+	/*!
+	 \brief Size class granularity (and alignment) of small blocks.
+	 */
+	static const size_t Granularity = 16;
+
+	/*!
+	 \brief Biggest block size served by the pools.
+	 */
+	static const size_t MaxBlockSize = 512;
+
+	/*!
+	 \brief Constructor.
+	 \param slab_size size of each slab requested from the system
+	 */
+	explicit PoolAllocator( size_t slab_size = 64 * 1024 );
+
+	/*!
+	 \brief Destructor. Releases every slab.
+	 */
+	virtual ~PoolAllocator( );
+
+	virtual void *Reallocate( void *ptr, size_t oldsize, size_t newsize );
+
+private:
+	PoolAllocator( const PoolAllocator & );
+	PoolAllocator &operator=( const PoolAllocator & );
+
+	static size_t SizeClass( size_t size );
+
+	void *Allocate( size_t size );
+	void Free( void *ptr, size_t size );
+
+	struct FreeBlock
+	{
+		FreeBlock *next;
+	};
+
+	size_t slab_size;
+	uint8_t *slab_current;
+	uint8_t *slab_end;
+	FreeBlock *free_lists[MaxBlockSize / Granularity];
+	std::vector<void *> slabs;
+};
+
+/*!
+ \brief Bump allocator that can be reset wholesale.
+ \details Allocations are carved sequentially from large chunks and
+ individual frees only reclaim memory when they release the most recent
+ allocation. All memory is reclaimed at once with Reset, after the
+ Interface using the arena has been destroyed. Well suited for short-lived
+ states with a bounded lifetime (like per-request sandboxes).
+ */
+class LUAINTERFACE_API ArenaAllocator : public Allocator
+{
+public:
+	/*!
+	 \brief Alignment of every block returned by the arena.
+	 */
+	static const size_t Alignment = 16;
+
+	/*!
+	 \brief Constructor.
+	 \param chunk_size size of each chunk requested from the system
+	 */
+	explicit ArenaAllocator( size_t chunk_size = 1024 * 1024 );
+
+	/*!
+	 \brief Destructor. Releases every chunk.
+	 */
+	virtual ~ArenaAllocator( );
+
+	virtual void *Reallocate( void *ptr, size_t oldsize, size_t newsize );
+
+	/*!
+	 \brief Discards every allocation made so far.
+	 \details Keeps the first chunk around for reuse and releases the
+	 rest. Must not be called while a Lua state still uses the arena.
+	 */
+	void Reset( );
+
+	/*!
+	 \brief Returns the number of bytes handed out since the last reset,
+	 including alignment padding and memory lost to non-trailing frees.
+	 \return number of bytes in use
+	 */
+	size_t GetUsage( ) const;
+
+private:
+	ArenaAllocator( const ArenaAllocator & );
+	ArenaAllocator &operator=( const ArenaAllocator & );
+
+	struct Chunk
+	{
+		Chunk *previous;
+		size_t size;
+		size_t used;
+	};
+
+	static size_t Align( size_t size );
+
+	uint8_t *Top( ) const;
+	void *Allocate( size_t size );
+
+	size_t chunk_size;
+	Chunk *current;
+	size_t usage;
+};
+
+/*!
+ \brief Allocator that enforces a hard cap on the memory used.
+ \details Keeps count of the bytes in use and refuses any request that
+ would make it go over the limit, which makes Lua run an emergency
+ collection and raise a memory error if that isn't enough. Forwards
+ the actual work to another allocator, or to the C runtime if none is
+ provided.
+ */
+class LUAINTERFACE_API LimitedAllocator : public Allocator
+{
+public:
+	/*!
+	 \brief Constructor.
+	 \param limit maximum number of bytes in use at any point
+	 \param parent allocator that does the actual allocations, or nullptr
+	 to use the C runtime
+	 */
+	explicit LimitedAllocator( size_t limit, Allocator *parent = nullptr );
+
+	virtual void *Reallocate( void *ptr, size_t oldsize, size_t newsize );
+
+	/*!
+	 \brief Returns the maximum number of bytes allowed in use.
+	 \return memory limit in bytes
+	 */
+	size_t GetLimit( ) const;
+
+	/*!
+	 \brief Changes the maximum number of bytes allowed in use.
+	 \details Lowering the limit below the current usage doesn't free
+	 anything, it only makes further growth fail.
+	 \param limit new memory limit in bytes
+	 */
+	void SetLimit( size_t limit );
+
+	/*!
+	 \brief Returns the number of bytes currently in use.
+	 \return memory usage in bytes
+	 */
+	size_t GetUsage( ) const;
+
+	/*!
+	 \brief Returns the highest number of bytes in use seen so far.
+	 \return peak memory usage in bytes
+	 */
+	size_t GetPeakUsage( ) const;
+
+private:
+	Allocator *parent;
+	size_t limit;
+	size_t usage;
+	size_t peak_usage;
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lua
+{
+
+/*!
+ \brief Caches the compiled bytecode of Lua files.
+ \details Once a file has been compiled, later loads of it (from
+ any Lua state using the cache) load the bytecode directly and skip
+ the parser. A cached entry is reused while the modification time and
+ size of the file are unchanged; when they change, the contents are
+ hashed and only recompiled if the hash differs too.
+ Optionally, the bytecode is also stored in a directory on disk,
+ so it survives between runs.
+ A single cache can be shared by every Lua state of the process
+ (it's thread-safe), as long as they use the same Lua build.
+ \sa Interface::SetBytecodeCache()
+ */
+class LUAINTERFACE_API BytecodeCache
+{
+public:
+	/*!
+	 \brief Constructor for a memory-only cache.
+	 */
+	BytecodeCache( );
+
+	/*!
+	 \brief Constructor for a cache that is also stored on disk.
+	 \param directory existing directory where compiled files are
+	 stored
+	 */
+	explicit BytecodeCache( const char *directory );
+
+	/*!
+	 \brief Loads a file as a Lua chunk, using cached bytecode
+	 when possible.
+	 \details Behaves like Interface::LoadFile without a cache.
+	 \param lua Interface where the chunk is loaded
+	 \param path path to the file
+	 \return 0 on success, a Lua error code otherwise
+	 */
+	int Load( Interface &lua, const char *path );
+
+	/*!
+	 \brief Removes every entry from the memory cache.
+	 */
+	void Clear( );
+
+private:
+	BytecodeCache( const BytecodeCache & );
+	BytecodeCache &operator=( const BytecodeCache & );
+
+	typedef std::shared_ptr<const std::vector<uint8_t> > Bytecode;
+
+	struct Entry
+	{
+		int64_t mtime;
+		uint64_t size;
+		uint64_t hash;
+		Bytecode bytecode;
+	};
+
+	Bytecode Find( const std::string &path, int64_t mtime, uint64_t size );
+	Bytecode FindHash( const std::string &path, int64_t mtime, uint64_t size, uint64_t hash );
+	void Store( const std::string &path, const Entry &entry );
+
+	std::string GetDiskPath( const std::string &path ) const;
+	bool ReadDisk( const std::string &path, Entry &entry ) const;
+	void WriteDisk( const std::string &path, const Entry &entry ) const;
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+	std::string directory;
+};
+
+}
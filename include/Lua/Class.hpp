@@ -0,0 +1,286 @@
+#pragma once
+
+#include <Lua/Interface.hpp>
+#include <Lua/Traits.hpp>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+/*!
+ \brief Generates a Lua C function that calls a C++ function on the
+ object at stack index 1.
+ \details method must be the qualified name of either a member function
+ of the bound class (taking and returning types supported by Traits) or
+ a free function with the signature int ( Lua::Interface &, T & ), which
+ works like a regular Lua C function that gets the object already checked.
+ The generated function must be pushed through Lua::Class.
+ \sa Lua::Class::Method()
+ */
+#define LUAINTERFACE_METHOD( method ) ( &Lua::Method<decltype( &method ), &method>::Call )
+
+namespace Lua
+{
+
+/*!
+ \brief Binds a C++ class to Lua as a full userdata type.
+ \details Creates (or reuses) the metatable registered for a TypeTag and
+ keeps it on the stack, together with a table of methods, until the
+ Class is destroyed. Every function added through it is pushed as a C
+ closure with the metatable as its first upvalue and the table of
+ methods as its second, which lets Check identify objects by comparing
+ metatables instead of looking them up in the registry by name on every
+ call. The metatable gets __name, __index (pointing at the table of
+ methods), __gc (calling the destructor of T) and __metatable fields by
+ default, so Lua code can't reach __gc. Destroyed objects have their
+ metatable removed, so Check raises an error on them and they aren't
+ destroyed again.
+
+ \code
+ static const Lua::TypeTag counter_type( "counter" );
+
+ Lua::Class<Counter> counter( lua, counter_type );
+ counter.Method( "add", LUAINTERFACE_METHOD( Counter::Add ) );
+ counter.PushFunction( CreateCounter );
+ \endcode
+ */
+template<typename T>
+class Class
+{
+public:
+	/*!
+	 \brief Constructor. Pushes the metatable and the table of
+	 methods of the class.
+	 \details Objects of the class can also be checked with
+	 Interface::CheckUserdata and the same tag.
+	 \param lua Interface where the class is registered
+	 \param tag userdata type of the class
+	 */
+	Class( Interface &lua, const TypeTag &tag ) :
+		lua( lua )
+	{
+		lua.NewMetatable( tag );
+		metatable = lua.GetTop( );
+
+		lua.CreateTable( );
+		methods = lua.GetTop( );
+
+		lua.PushString( tag.GetName( ) );
+		lua.SetField( metatable, "__name" );
+
+		lua.PushValue( methods );
+		lua.SetField( metatable, "__index" );
+
+		PushFunction( Destroy );
+		lua.SetField( metatable, "__gc" );
+
+		lua.PushBoolean( false );
+		lua.SetField( metatable, "__metatable" );
+	}
+
+	/*!
+	 \brief Destructor. Pops the metatable and the table of methods
+	 of the class.
+	 */
+	~Class( )
+	{
+		lua.Remove( methods );
+		lua.Remove( metatable );
+	}
+
+	/*!
+	 \brief Returns the stack index of the metatable.
+	 \return absolute stack index of the metatable
+	 */
+	int GetMetaTable( ) const
+	{
+		return metatable;
+	}
+
+	/*!
+	 \brief Returns the stack index of the table of methods.
+	 \return absolute stack index of the table of methods
+	 */
+	int GetMethods( ) const
+	{
+		return methods;
+	}
+
+	/*!
+	 \brief Adds a method to the class.
+	 \details Names starting with two underscores are metamethods
+	 (like __tostring or __index) and are added to (or replaced in)
+	 the metatable instead of the table of methods.
+	 \param name name of the method
+	 \param func function to be added, usually generated by
+	 LUAINTERFACE_METHOD
+	 \return reference to this Class, for chaining
+	 */
+	Class &Method( const char *name, Function func )
+	{
+		PushFunction( func );
+		lua.SetField( name[0] == '_' && name[1] == '_' ? metatable : methods, name );
+		return *this;
+	}
+
+	/*!
+	 \brief Pushes a function bound to the class, without adding
+	 it to the metatable.
+	 \details Used for functions that create objects with New,
+	 like constructors.
+	 \param func function to be pushed
+	 */
+	void PushFunction( Function func )
+	{
+		lua.PushValue( metatable );
+		lua.PushValue( methods );
+		lua.PushClosure( func, 2 );
+	}
+
+	/*!
+	 \brief Constructs a new object in a full userdata and pushes it.
+	 \details Must only be called from functions bound to the class.
+	 \param lua Interface of the running function
+	 \param args arguments forwarded to the constructor of T
+	 \return reference to the new object
+	 */
+	template<typename... Args>
+	static T &New( Interface &lua, Args &&... args )
+	{
+		void *userdata = lua.NewUserdata( sizeof( T ) );
+		T *object = new( userdata ) T( std::forward<Args>( args )... );
+		lua.PushValue( Interface::UpvalueIndex( 1 ) );
+		lua.SetMetaTable( -2 );
+		return *object;
+	}
+
+	/*!
+	 \brief Returns the object at the given index, or nullptr if
+	 it's not an object of this class.
+	 \details Must only be called from functions bound to the class.
+	 \param lua Interface of the running function
+	 \param stackpos stack index of the object
+	 \return pointer to the object or nullptr
+	 */
+	static T *Test( Interface &lua, int stackpos )
+	{
+		void *userdata = lua.ToUserdata( stackpos );
+		if( userdata == nullptr || lua.GetMetaTable( stackpos ) == 0 )
+			return nullptr;
+
+		bool same = lua.RawEqual( -1, Interface::UpvalueIndex( 1 ) ) != 0;
+		lua.Pop( 1 );
+		return same ? static_cast<T *>( userdata ) : nullptr;
+	}
+
+	/*!
+	 \brief Returns the object at the given index, raising a Lua
+	 error if it's not an object of this class.
+	 \details Must only be called from functions bound to the class.
+	 \param lua Interface of the running function
+	 \param stackpos stack index of the object
+	 \return pointer to the object
+	 */
+	static T *Check( Interface &lua, int stackpos = 1 )
+	{
+		T *object = Test( lua, stackpos );
+		if( object == nullptr )
+		{
+			lua.GetField( Interface::UpvalueIndex( 1 ), "__name" );
+			lua.TypeError( stackpos, lua.ToString( -1 ) );
+		}
+
+		return object;
+	}
+
+private:
+	Class( const Class & );
+	Class &operator=( const Class & );
+
+	// Removing the metatable marks the object as destroyed
+	static int Destroy( lua_State *state )
+	{
+		Interface &lua = GetLuaInterface( state );
+		T *object = Test( lua, 1 );
+		if( object != nullptr )
+		{
+			lua.PushNil( );
+			lua.SetMetaTable( 1 );
+			object->~T( );
+		}
+
+		return 0;
+	}
+
+	Interface &lua;
+	int metatable;
+	int methods;
+};
+
+namespace Internal
+{
+
+template<typename Result, typename... Args>
+struct Invoker
+{
+	template<typename T, typename Member, size_t... Indices>
+	static int Call( Interface &lua, T &self, Member member, IndexSequence<Indices...> )
+	{
+		Traits<typename std::decay<Result>::type>::Push( lua, ( self.*member )( Traits<typename std::decay<Args>::type>::Check( lua, static_cast<int>( Indices ) + 2 )... ) );
+		return 1;
+	}
+};
+
+template<typename... Args>
+struct Invoker<void, Args...>
+{
+	template<typename T, typename Member, size_t... Indices>
+	static int Call( Interface &lua, T &self, Member member, IndexSequence<Indices...> )
+	{
+		static_cast<void>( lua );
+		( self.*member )( Traits<typename std::decay<Args>::type>::Check( lua, static_cast<int>( Indices ) + 2 )... );
+		return 0;
+	}
+};
+
+}
+
+/*!
+ \brief Generates Lua C functions from C++ functions at compile time.
+ \details Usually instantiated through LUAINTERFACE_METHOD.
+ */
+template<typename Signature, Signature Func>
+struct Method;
+
+template<typename T, typename Result, typename... Args, Result ( T::*Member )( Args... )>
+struct Method<Result ( T::* )( Args... ), Member>
+{
+	static int Call( lua_State *state )
+	{
+		Interface &lua = GetLuaInterface( state );
+		T &self = *Class<T>::Check( lua );
+		return Internal::Invoker<Result, Args...>::Call( lua, self, Member, typename Internal::MakeIndexSequence<sizeof...( Args )>::Type( ) );
+	}
+};
+
+template<typename T, typename Result, typename... Args, Result ( T::*Member )( Args... ) const>
+struct Method<Result ( T::* )( Args... ) const, Member>
+{
+	static int Call( lua_State *state )
+	{
+		Interface &lua = GetLuaInterface( state );
+		const T &self = *Class<T>::Check( lua );
+		return Internal::Invoker<Result, Args...>::Call( lua, self, Member, typename Internal::MakeIndexSequence<sizeof...( Args )>::Type( ) );
+	}
+};
+
+template<typename T, int ( *Func )( Interface &, T & )>
+struct Method<int ( * )( Interface &, T & ), Func>
+{
+	static int Call( lua_State *state )
+	{
+		Interface &lua = GetLuaInterface( state );
+		return Func( lua, *Class<T>::Check( lua ) );
+	}
+};
+
+}
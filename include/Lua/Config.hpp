@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdexcept>
+#include <chrono>
 
 #if defined _MSC_VER
 
@@ -36,6 +37,24 @@
 
 #endif
 
+/*!
+ \brief Marks the Interface members defined in Lua/InterfaceInline.hpp.
+ \details Consumers of the shared library may define
+ LUAINTERFACE_INLINE to have these members inlined in their code
+ (requires the Lua headers on the include path). The library itself
+ always provides out-of-line, exported definitions for them.
+ */
+#if defined LUAINTERFACE_INLINE && !defined LUAINTERFACE_EXPORT && !defined LUAINTERFACE_STATIC
+
+#define LUAINTERFACE_INLINE_API inline
+
+#else
+
+#undef LUAINTERFACE_INLINE
+#define LUAINTERFACE_INLINE_API
+
+#endif
+
 /*!
  \brief Forward declaration of the lua_State struct.
  */
@@ -76,6 +95,19 @@ enum class GC
 	SetStepMul
 };
 
+/*!
+ \brief Work done by a time-budgeted garbage collection.
+ \sa Interface::CollectFor()
+ \sa Interface::CollectIdle()
+ */
+struct CollectResult
+{
+	std::chrono::microseconds elapsed;	///< time spent collecting
+	size_t steps;						///< incremental steps performed
+	bool cycle_finished;				///< whether a collection cycle ended
+	size_t bytes_freed;					///< decrease of the memory in use
+};
+
 enum class Status
 {
 	Success,
@@ -86,11 +118,59 @@ enum class Status
 	ErrorHandler
 };
 
+/*!
+ \brief Defines the standard libraries opened by Interface.
+ \details Values can be combined with the | operator. Libraries not
+ provided by the Lua version in use are ignored (like UTF8 on Lua 5.1
+ or JIT and FFI outside of LuaJIT). Bit opens bit32 on Lua 5.3 (when
+ built with LUA_COMPAT_BITLIB) and bit on LuaJIT.
+ */
+enum class Library : uint32_t
+{
+	None = 0,
+	Base = 1 << 0,			///< basic functions, never lazy
+	Package = 1 << 1,		///< package library and require, never lazy
+	Coroutine = 1 << 2,		///< coroutine library (part of Base on Lua 5.1)
+	String = 1 << 3,		///< string library
+	Table = 1 << 4,			///< table library
+	IO = 1 << 5,			///< io library
+	OS = 1 << 6,			///< os library
+	Math = 1 << 7,			///< math library
+	UTF8 = 1 << 8,			///< utf8 library
+	Debug = 1 << 9,			///< debug library
+	Bit = 1 << 10,			///< bit32 or bit library
+	JIT = 1 << 11,			///< jit library
+	FFI = 1 << 12,			///< ffi library
+	All = 0xFFFFFFFF		///< every library, like luaL_openlibs
+};
+
+inline Library operator|( Library a, Library b )
+{
+	return static_cast<Library>( static_cast<uint32_t>( a ) | static_cast<uint32_t>( b ) );
+}
+
+inline Library operator&( Library a, Library b )
+{
+	return static_cast<Library>( static_cast<uint32_t>( a ) & static_cast<uint32_t>( b ) );
+}
+
+inline Library operator~( Library a )
+{
+	return static_cast<Library>( ~static_cast<uint32_t>( a ) );
+}
+
 /*!
  \brief Forward declaration of the Interface class.
  */
 class Interface;
 
+/*!
+ \brief Forward declaration of the Traits struct.
+ \sa Traits.hpp
+ */
+template<typename T, typename Enable = void>
+struct Traits;
+
 class InvalidStackIndex : public std::runtime_error
 {
 public:
@@ -133,8 +213,8 @@ private:
 };
 
 /*!
- \brief Offset of the Lua Interface object from the start
- of the lua_State struct.
+ \brief Offset of the Lua Interface object pointer from the
+ start of the lua_State struct.
  */
 extern LUAINTERFACE_API const size_t InterfaceOffset;
 
@@ -154,6 +234,12 @@ static const int ReferenceNil = -1;
  */
 static const int ReferenceInvalid = -2;
 
+/*!
+ \brief Number of released Object references queued before
+ they're freed in a batch.
+ */
+static const size_t ReferenceReleaseBatch = 64;
+
 /*!
  \brief Lua C function prototype.
  */
@@ -164,6 +250,12 @@ typedef int ( *Function )( lua_State *state );
  */
 typedef int ( *Writer ) ( lua_State *state, const void *data, size_t size, void *userdata );
 
+/*!
+ \brief Called when Lua no longer needs the memory of a string view.
+ \sa Interface::PushStringView
+ */
+typedef void ( *StringViewRelease )( const char *data, size_t len, void *userdata );
+
 /*!
  \brief A struct with functions for a module to be registered with
  State::Register.
@@ -193,8 +285,7 @@ struct Buffer;
  from the lua_State struct.
  Recommended way to use this is to set a variable at the
  top of the function with the value returned and use it.
+ \details Lua threads (coroutines) only get their Interface
+ object the first time it is requested.
  */
-inline Lua::Interface &GetLuaInterface( lua_State *state )
-{
-	return *reinterpret_cast<Lua::Interface *>( &state->internal_data[Lua::InterfaceOffset] );
-}
+inline Lua::Interface &GetLuaInterface( lua_State *state );
@@ -2,10 +2,25 @@
 
 #include <Lua/Config.hpp>
 #include <Lua/Object.hpp>
+#include <Lua/Allocator.hpp>
+#include <Lua/StringBuilder.hpp>
+#include <Lua/TypeTag.hpp>
+#include <Lua/BytecodeCache.hpp>
+#include <Lua/StatePool.hpp>
+#include <Lua/Metrics.hpp>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <tuple>
 
 namespace Lua
 {
 
+class Profiler;
+class MetricCounters;
+
 class LUAINTERFACE_API Interface
 {
 public:
@@ -26,6 +41,42 @@ public:
 	 */
 	Interface( );
 
+	/*!
+	 \brief Constructor that uses a custom allocator for
+	 every memory request of the Lua state.
+	 \details The allocator must outlive the Interface.
+	 Throws std::runtime_error if the state can't be created
+	 (LuaJIT doesn't support custom allocators on 64-bit targets).
+	 \sa Allocator
+	 \param allocator allocator used by the Lua state
+	 */
+	explicit Interface( Allocator &allocator );
+
+	/*!
+	 \brief Constructor that only opens the given standard libraries.
+	 \details Libraries in lazy are only opened the first time
+	 their global is accessed, through an __index metamethod set on
+	 the globals table (replacing that metatable disables it). They
+	 can also be loaded through require when Package is opened. A
+	 lazy String is also opened the first time a method is called
+	 on a string value (like ("abc"):upper()).
+	 Libraries in both sets are opened right away, as are Base and
+	 Package when requested lazily.
+	 \param libraries libraries opened right away
+	 \param lazy libraries opened on first access
+	 */
+	explicit Interface( Library libraries, Library lazy = Library::None );
+
+	/*!
+	 \brief Constructor that uses a custom allocator and only opens
+	 the given standard libraries.
+	 \sa Interface( Allocator & ), Interface( Library, Library )
+	 \param allocator allocator used by the Lua state
+	 \param libraries libraries opened right away
+	 \param lazy libraries opened on first access
+	 */
+	Interface( Allocator &allocator, Library libraries, Library lazy = Library::None );
+
 	/*!
 	 \brief Destructor.
 	 */
@@ -152,6 +203,25 @@ public:
 	 */
 	void GetMetaTable( const char *name );
 
+	/*!
+	 \brief Pushes onto the stack the metatable of the userdata
+	 type tag, creating and registering it if needed.
+	 \details The metatable is also stored in the registry under
+	 the name of the tag, like NewMetatable( const char * ) does.
+	 \sa TypeTag
+	 \param tag userdata type
+	 \return 1 if metatable was created, 0 if it already existed
+	 */
+	int NewMetatable( const TypeTag &tag );
+
+	/*!
+	 \brief Pushes onto the stack the metatable registered for
+	 the userdata type tag, or nil if there's none.
+	 \sa NewMetatable()
+	 \param tag userdata type
+	 */
+	void GetMetaTable( const TypeTag &tag );
+
 	/*!
 	 \brief Pushes onto the stack the metatable of the
 	 value at the given acceptable index.
@@ -224,6 +294,10 @@ public:
 	 In case of runtime errors, this function will be
 	 called with the error message and its return value
 	 will be the message returned on the stack by PCall.
+	 With the bundled Lua 5.3, C++ exceptions thrown by C
+	 functions are errors too: std::bad_alloc is a memory
+	 error and anything else is a runtime error with the
+	 message of the exception (passed to the error handler).
 	 \sa Call()
 	 \param args number of arguments for the function
 	 \param results number of results retrieved from the function
@@ -405,6 +479,56 @@ public:
 	 */
 	void *CheckUserdata( int stackpos, const char *name );
 
+	/*!
+	 \brief Checks whether the function argument stackpos
+	 is a userdata of the type tag.
+	 \details Raises a Lua error otherwise.
+	 \sa TestUserdata()
+	 \param stackpos position in stack of the argument
+	 \param tag userdata type
+	 \return memory block of the userdata
+	 */
+	void *CheckUserdata( int stackpos, const TypeTag &tag );
+
+	/*!
+	 \brief Checks whether the function argument stackpos
+	 is a userdata of the type tag.
+	 \sa CheckUserdata()
+	 \param stackpos position in stack of the argument
+	 \param tag userdata type
+	 \return memory block of the userdata
+	 */
+	template<typename Type> Type *CheckUserdata( int stackpos, const TypeTag &tag )
+	{
+		return static_cast<Type *>( CheckUserdata( stackpos, tag ) );
+	}
+
+	/*!
+	 \brief Checks whether the value at stackpos is a userdata
+	 of the type tag.
+	 \details Only compares the metatable of the value with the one
+	 registered for the tag.
+	 \sa NewMetatable()
+	 \param stackpos stack index of the value
+	 \param tag userdata type
+	 \return memory block of the userdata, or nullptr if the value
+	 isn't of the type tag
+	 */
+	void *TestUserdata( int stackpos, const TypeTag &tag );
+
+	/*!
+	 \brief Checks whether the value at stackpos is a userdata
+	 of the type tag.
+	 \sa TestUserdata()
+	 \param stackpos stack index of the value
+	 \param tag userdata type
+	 \return memory block of the userdata, or nullptr
+	 */
+	template<typename Type> Type *TestUserdata( int stackpos, const TypeTag &tag )
+	{
+		return static_cast<Type *>( TestUserdata( stackpos, tag ) );
+	}
+
 	/*!
 	 \brief Checks whether the function has an argument
 	 of any type (including nil) at position stackpos.
@@ -478,6 +602,17 @@ public:
 	 */
 	void RawSetI( int stackpos, int n );
 
+	/*!
+	 \brief Returns the raw length of the value at the given
+	 index, without calling metamethods.
+	 \details For tables, it's the length of the sequence, like
+	 the length operator. For strings and userdata, it's the size
+	 in bytes. For anything else it's 0.
+	 \param stackpos position in stack of the value
+	 \return length of the value
+	 */
+	size_t RawLen( int stackpos );
+
 	/*!
 	 \brief Receives a list of C functions and their
 	 respective names and registers all of them inside
@@ -551,6 +686,20 @@ public:
 	 */
 	long long ToInteger( int stackpos );
 
+	/*!
+	 \brief Checks if the Lua value at the given acceptable
+	 index converts exactly to the signed integral type long
+	 long with ToInteger.
+	 \details On Lua 5.3 this is true for integers and for
+	 floats and strings with an integral value in range. On
+	 other versions, it's true for numbers (or strings
+	 convertible to them) with an integral value in range.
+	 \sa ToInteger()
+	 \param stackpos stack index of the value
+	 \return true if the value is an integer, false otherwise
+	 */
+	bool IsInteger( int stackpos );
+
 	/*!
 	 \brief Converts the Lua value at the given
 	 acceptable index to a boolean.
@@ -636,6 +785,31 @@ public:
 		return static_cast<Type *>( NewUserdata( size ) );
 	}
 
+	/*!
+	 \brief Creates a new userdata of the type tag on the top of
+	 the stack.
+	 \details Works like NewUserdata( size_t ), but also sets the
+	 metatable registered for the tag.
+	 \sa NewMetatable()
+	 \param size the size of the memory block
+	 \param tag userdata type
+	 \return memory block of the userdata
+	 */
+	void *NewUserdata( size_t size, const TypeTag &tag );
+
+	/*!
+	 \brief Creates a new userdata of the type tag on the top of
+	 the stack.
+	 \sa NewUserdata()
+	 \param size the size of the memory block
+	 \param tag userdata type
+	 \return memory block of the userdata
+	 */
+	template<typename Type> Type *NewUserdata( size_t size, const TypeTag &tag )
+	{
+		return static_cast<Type *>( NewUserdata( size, tag ) );
+	}
+
 	/*!
 	 \brief Creates a new thread, pushes it on the stack,
 	 and returns a pointer to a lua_State that represents
@@ -723,6 +897,9 @@ public:
 	 \brief Allocates and initializes a buffer.
 	 \details Always call BufferFinish with the returned value
 	 to properly dispose of the memory allocated to it.
+	 \deprecated The buffer is allocated on the heap and leaks
+	 if a Lua error happens before BufferFinish. Use StringBuilder
+	 instead.
 	 \return Buffer struct
 	 */
 	Buffer *BufferInit( );
@@ -847,6 +1024,45 @@ public:
 	 */
 	void PushString( const char *val );
 
+	/*!
+	 \brief Pushes a read-only view of externally owned memory
+	 onto the stack, without copying it.
+	 \details The view is a userdata that works like a string for
+	 #, tostring, .. and == (between views), and has the sub, byte, len and
+	 tostring methods, which behave like the string functions of
+	 the same name. The memory at data must stay valid and
+	 unchanged until release is called, which happens when the
+	 view is collected (or right away if pushing fails). C modules
+	 can read views through Lua/StringView.h.
+	 \param data memory to be viewed
+	 \param len size of the memory
+	 \param release function called when the view is collected,
+	 may be nullptr
+	 \param userdata passed to release
+	 */
+	void PushStringView( const char *data, size_t len, StringViewRelease release = nullptr, void *userdata = nullptr );
+
+	/*!
+	 \brief Returns the contents of the string or string view at
+	 the given index.
+	 \details Unlike ToString, numbers aren't converted.
+	 \param stackpos stack index of the value
+	 \param outlen length of the contents
+	 \return contents of the string or view, or nullptr for
+	 other values
+	 */
+	const char *ToStringView( int stackpos, size_t *outlen = nullptr );
+
+	/*!
+	 \brief Checks whether the function argument stackpos is a
+	 string or a string view and returns its contents.
+	 \details Numbers are converted like with CheckString.
+	 \param stackpos position in stack of the argument
+	 \param outlen length of the contents
+	 \return contents of the string or view
+	 */
+	const char *CheckStringView( int stackpos, size_t *outlen = nullptr );
+
 	/*!
 	 \brief Pushes onto the stack a formatted string and
 	 returns a pointer to this string.
@@ -950,6 +1166,15 @@ public:
 	 */
 	void PushClosure( Function val, int vars );
 
+	/*!
+	 \brief Returns the pseudo-index of an upvalue of the
+	 running C closure.
+	 \sa PushClosure()
+	 \param index index of the upvalue, starting at 1
+	 \return pseudo-index that can be used like a stack index
+	 */
+	static int UpvalueIndex( int index );
+
 	/*!
 	 \brief Pushes a light userdata onto the stack.
 	 \details Userdata represent C values in Lua. A
@@ -999,10 +1224,110 @@ public:
 	 \brief Loads a file as a Lua chunk.
 	 \details If filename is NULL, then
 	 it loads from the standard input.
+	 Goes through the bytecode cache, if one is set.
+	 \sa SetBytecodeCache()
 	 \param path path to the file
 	 */
 	int LoadFile( const char *path );
 
+	/*!
+	 \brief Sets the cache used by LoadFile and RunFile to
+	 skip compiling unchanged files.
+	 \details Applies to every thread of the Lua state. The cache
+	 must outlive the Interface, or be unset before being destroyed.
+	 \param cache bytecode cache, or nullptr to disable caching
+	 */
+	void SetBytecodeCache( BytecodeCache *cache );
+
+	/*!
+	 \brief Starts the sampling profiler of the Lua state.
+	 \details A timer arms a count hook on the main Lua thread
+	 frequency times per second, which takes a sample of the stack
+	 on the next VM instruction and disarms itself, so there's no
+	 overhead between samples. On Linux the timer sends SIGPROF to
+	 the thread calling StartProfiler, which must be the one running
+	 the Lua state, and the hook is armed by its signal handler
+	 (chaining to any previous handler for signals of other
+	 sources). Elsewhere a timer thread arms the hook while the
+	 state runs, which is a data race: a sample might be lost. Samples are aggregated
+	 as folded stacks, see DumpProfile. A hook already set on the
+	 main thread (with the debug library or by a debugger) is kept:
+	 the profiler hook replaces it for a single instruction per
+	 sample and puts it back afterwards (and when the profiler
+	 stops), so it might miss the events of sampled instructions.
+	 On Lua 5.3 only the
+	 main thread is sampled: a sample requested while a coroutine
+	 runs is taken once control returns to the main thread. On
+	 LuaJIT hooks apply to every thread, but compiled code doesn't
+	 run them, so it isn't sampled.
+	 \param frequency number of samples per second
+	 */
+	void StartProfiler( unsigned int frequency = 1000 );
+
+	/*!
+	 \brief Stops the sampling profiler, keeping its samples.
+	 */
+	void StopProfiler( );
+
+	/*!
+	 \brief Discards the samples taken by the profiler.
+	 */
+	void ClearProfile( );
+
+	/*!
+	 \brief Writes the samples taken by the profiler in the folded
+	 stack format, ready for flamegraph tools.
+	 \details Each line has the frames of a stack, from the
+	 outermost, separated by semicolons, followed by a space and
+	 the number of samples taken in it.
+	 \param file file opened for writing
+	 \return true if the samples were written, false otherwise
+	 */
+	bool DumpProfile( FILE *file );
+
+	/*!
+	 \brief Pushes a table mapping the folded stacks sampled by
+	 the profiler to the number of samples taken in them.
+	 \sa DumpProfile()
+	 */
+	void PushProfile( );
+
+	/*!
+	 \brief Replaces a loaded C module with a new build of its
+	 shared library, keeping the Lua state running.
+	 \details Finds the library like the C searcher of require, opens
+	 the new build from a copy of the file in the temporary directory
+	 and calls its luaopen_ function, which stores the new module in
+	 package.loaded (and replaces the old module in the globals
+	 table, if it's there). Only then the unload function of the old
+	 library is called; if the new build fails to open, the old
+	 library and module are left loaded and working. The code of the
+	 old library stays loaded until the state is closed, so
+	 functions and callbacks of live objects created by it (like
+	 finalizers of userdata or views) keep working. Modules built
+	 with Class (or that reuse their metatables by name) update the
+	 metatables of live userdata, so they use the new code.
+	 Finally, if the library exports a lua_CFunction named
+	 luamigrate_ followed by the name of the module (like luaopen_),
+	 it's called with the old and the new modules, to migrate the
+	 state of the module. The garbage collector is stopped during
+	 the reload.
+	 \param name name of the module, as given to require
+	 \return true and the new module pushed on the stack if the
+	 module was reloaded, false and the error message pushed
+	 otherwise
+	 */
+	bool ReloadModule( const char *name );
+
+	/*!
+	 \brief Returns the runtime counters of the Lua state.
+	 \details The counters are updated as the Lua state runs,
+	 with no locking, and can be read from any thread while it
+	 runs, though counters aren't read atomically as a group.
+	 \return snapshot of the counters
+	 */
+	Metrics GetMetrics( );
+
 	/*!
 	 \brief Creates and returns a reference.
 	 \details If the object at the top of the
@@ -1056,6 +1381,37 @@ public:
 	 */
 	int GarbageCollect( GC what, int data = 0 );
 
+	/*!
+	 \brief Runs incremental garbage collection steps until the
+	 budget is spent or the current cycle ends.
+	 \details At least one step is performed, and the last step
+	 may overrun the budget. Works even if the collector is
+	 stopped. When called between cycles, it starts a new one.
+	 Like lua_gc( LUA_GCSTEP, 0 ), every step leaves the collector
+	 an allowance of about one step of allocations before its next
+	 automatic step (discarding the allowance it had), unless it
+	 finishes the cycle, which sets the allowance from the pause.
+	 \param budget time to spend collecting
+	 \return work done
+	 */
+	CollectResult CollectFor( std::chrono::microseconds budget );
+
+	/*!
+	 \brief Collects garbage while the Lua state is idle, like
+	 between requests in an event loop.
+	 \details Like CollectFor, but between cycles it only starts
+	 a new one when the collector would otherwise start it within
+	 the next allocations of half the memory in use, so idle
+	 states don't run cycles back to back. Work done here isn't
+	 credited as allocation allowance, but it moves the current
+	 cycle forward, so less of it is left to the automatic steps
+	 taken while the state is busy, and a cycle finished here
+	 delays the next one by the pause as usual.
+	 \param budget time to spend collecting
+	 \return work done, with no steps if there was nothing to do
+	 */
+	CollectResult CollectIdle( std::chrono::microseconds budget );
+
 	/*!
 	 \brief Returns the type of the value in the
 	 given acceptable index, or Type::None for
@@ -1101,10 +1457,47 @@ public:
 
 	/*!
 	 \brief Pushes a a Lua object onto the stack.
+	 \details Invalid objects are pushed as nil.
 	 \param val object to be pushed
 	 */
 	void PushObject( const Object &obj );
 
+	/*!
+	 \brief Frees the references of every Object destroyed
+	 since the last flush.
+	 \details Destroying an Object only queues its reference,
+	 which is freed later in a batch (every ReferenceReleaseBatch
+	 references created or when this function is called). Can be
+	 called from the Interface of any thread of the Lua state.
+	 */
+	void FlushReferences( );
+
+	/*!
+	 \brief Chooses where the values of Object handles are kept.
+	 \details By default they're kept in the registry, shared with
+	 ReferenceCreate and any C code using luaL_ref. A dedicated table
+	 keeps the registry small and its free list uncontended. Can only
+	 be changed while no Object of this Lua state is alive.
+	 \param enable true to use a dedicated table, false to use the
+	 registry
+	 \return true if the storage was changed, false otherwise
+	 */
+	bool SetReferenceTable( bool enable );
+
+	/*!
+	 \brief Makes the calling thread the owner of the Lua state.
+	 \details The owner is the thread that created the main
+	 Interface. Objects destroyed on any other thread don't touch
+	 the Lua state, their references are pushed to a lock-free queue
+	 that the owner drains on PCall, FlushReferences and after every
+	 garbage collection cycle. If there's no memory left for the
+	 queue, they're pushed to a small fixed size queue instead, and
+	 the destroying thread waits for the owner to drain it when it's
+	 full. Call this after handing the Lua state over to another
+	 thread.
+	 */
+	void SetOwnerThread( );
+
 	/*!
 	 \brief Throws a Lua error.
 	 \param error a string detailing the error
@@ -1113,79 +1506,226 @@ public:
 	*/
 	int ThrowError( const char *fmt, ... );
 
-	void SCall( )
-	{
-		Call( pushed_scall );
-		pushed_scall = 0;
-	}
+	/*!
+	 \brief Calls the function on the stack with the given arguments
+	 and returns its results converted to C++ values.
+	 \details The function must be pushed before calling this. Every
+	 argument is pushed with Traits<Arg>::Push (Arg decayed, so C
+	 functions and arrays are pushed as pointers) and every result is
+	 read with Traits<Result>::Get, in order, then popped. Errors are
+	 raised like with Call. Results are given explicitly as template
+	 arguments, the arguments are deduced, for example:
+
+	 \code
+	 lua.PushGlobal( );
+	 lua.GetField( -1, "math" );
+	 lua.GetField( -1, "max" );
+	 long long result = std::get<0>( lua.SCall<long long>( 1, 3, 2 ) );
+	 \endcode
+
+	 These aren't overloads of Call and PCall because a call with only
+	 integer arguments, like Call( 1, 2 ), would silently pick the
+	 non-template versions.
+	 \sa Traits
+	 \param args arguments passed to the function
+	 \return tuple with the results of the function
+	 */
+	template<typename... Results, typename... Args>
+	std::tuple<Results...> SCall( const Args &... args );
+
+	/*!
+	 \brief Calls the function on the stack with the given arguments
+	 in protected mode and stores its results converted to C++ values.
+	 \details Works like SCall, but on errors the error message is left
+	 on the stack, like with PCall, and results is left untouched.
+	 \sa SCall()
+	 \param results tuple where the results of the function are stored
+	 \param args arguments passed to the function
+	 \return true if the function ran successfully, false otherwise
+	 */
+	template<typename... Results, typename... Args>
+	bool SPCall( std::tuple<Results...> &results, const Args &... args );
+
+	/*!
+	 \brief Reads numbers from a table into a buffer.
+	 \details Reads the elements offset + 1 to offset + count of the
+	 table at stackpos, without calling metamethods, and stops at
+	 the first one that isn't a number (or a string convertible to
+	 a number). Elements in the array part of the table are read
+	 directly, without going through the stack.
+	 \param stackpos position in stack of the table
+	 \param values buffer of at least count numbers
+	 \param count number of elements to read
+	 \param offset number of elements to skip
+	 \return number of elements read, 0 if the value isn't a table
+	 */
+	size_t ReadArray( int stackpos, double *values, size_t count, size_t offset = 0 );
 
-	template<typename ...ArgsTypes> void SCall( std::nullptr_t, ArgsTypes... args )
-	{
-		PushNil( );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Reads integers from a table into a buffer.
+	 \details Like ReadArray( int, double *, size_t, size_t ), but
+	 stops at the first element that isn't an integer (or a number
+	 convertible to one, with the same rules as ToInteger).
+	 \param stackpos position in stack of the table
+	 \param values buffer of at least count integers
+	 \param count number of elements to read
+	 \param offset number of elements to skip
+	 \return number of elements read, 0 if the value isn't a table
+	 */
+	size_t ReadArray( int stackpos, long long *values, size_t count, size_t offset = 0 );
+
+	/*!
+	 \brief Reads the sequence of a table into a vector.
+	 \details The vector is resized to the length of the table
+	 (see RawLen). Arithmetic types are read in bulk, like with
+	 ReadArray( int, double *, size_t, size_t ); if an element isn't
+	 a number (or is out of the range of Type), the vector is
+	 truncated to the elements before it.
+	 Other types (including your own structs) are read one by one
+	 with Traits<Type>::Get.
+	 \param stackpos position in stack of the table
+	 \param values vector where the elements are stored
+	 \return true if every element was read, false otherwise
+	 */
+	template<typename Type>
+	bool ReadArray( int stackpos, std::vector<Type> &values );
 
-	template<typename ...ArgsTypes> void SCall( const char *arg, ArgsTypes... args )
-	{
-		PushString( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Writes numbers from a buffer into a table.
+	 \details Sets the elements offset + 1 to offset + count of the
+	 table at stackpos, without calling metamethods. Elements that
+	 fall in the array part of the table are written directly.
+	 \param stackpos position in stack of the table
+	 \param values buffer of count numbers
+	 \param count number of elements to write
+	 \param offset number of elements to skip
+	 */
+	void WriteArray( int stackpos, const double *values, size_t count, size_t offset = 0 );
 
-	template<typename ...ArgsTypes> void SCall( double arg, ArgsTypes... args )
-	{
-		PushNumber( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Writes integers from a buffer into a table.
+	 \sa WriteArray( int, const double *, size_t, size_t )
+	 \param stackpos position in stack of the table
+	 \param values buffer of count integers
+	 \param count number of elements to write
+	 \param offset number of elements to skip
+	 */
+	void WriteArray( int stackpos, const long long *values, size_t count, size_t offset = 0 );
 
-	template<typename ...ArgsTypes> void SCall( long long arg, ArgsTypes... args )
-	{
-		PushInteger( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Pushes a new table with the numbers of a buffer as
+	 its sequence.
+	 \details The table is created with an array part big enough
+	 for every element, which are written into it directly.
+	 \param values buffer of count numbers
+	 \param count number of elements
+	 */
+	void PushArray( const double *values, size_t count );
 
-	template<typename ...ArgsTypes> void SCall( bool arg, ArgsTypes... args )
-	{
-		PushBoolean( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Pushes a new table with the integers of a buffer as
+	 its sequence.
+	 \sa PushArray( const double *, size_t )
+	 \param values buffer of count integers
+	 \param count number of elements
+	 */
+	void PushArray( const long long *values, size_t count );
 
-	template<typename ...ArgsTypes> void SCall( Function arg, ArgsTypes... args )
-	{
-		PushFunction( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Pushes a new table with the values of a buffer as its
+	 sequence.
+	 \details Arithmetic types are written in bulk, like with
+	 PushArray( const double *, size_t ). Other types are pushed one
+	 by one with Traits<Type>::Push.
+	 \param values buffer of count values
+	 \param count number of elements
+	 */
+	template<typename Type>
+	void PushArray( const Type *values, size_t count );
 
-	template<typename ...ArgsTypes> void SCall( lua_State *arg, ArgsTypes... args )
-	{
-		PushThread( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Pushes a new table with the values of a vector as its
+	 sequence.
+	 \sa PushArray( const Type *, size_t )
+	 \param values vector of values
+	 */
+	template<typename Type>
+	void PushArray( const std::vector<Type> &values );
 
-	template<typename ...ArgsTypes> void SCall( const Object &arg, ArgsTypes... args )
-	{
-		PushObject( arg );
-		++pushed_scall;
-		return SCall( args );
-	}
+	/*!
+	 \brief Reads the key-value pairs of a table into a map.
+	 \details The map (std::map, std::unordered_map or anything
+	 with the same interface) is cleared first. Keys and values
+	 are read with Traits<Map::key_type>::Get and
+	 Traits<Map::mapped_type>::Get, without calling metamethods.
+	 \param stackpos position in stack of the table
+	 \param map map where the pairs are stored
+	 \return true if the value is a table, false otherwise
+	 */
+	template<typename Map>
+	bool ReadMap( int stackpos, Map &map );
+
+	/*!
+	 \brief Pushes a new table with the key-value pairs of a map.
+	 \details Keys and values are pushed with
+	 Traits<Map::key_type>::Push and Traits<Map::mapped_type>::Push.
+	 \param map map of key-value pairs
+	 */
+	template<typename Map>
+	void PushMap( const Map &map );
 
 	/*!
 	 \brief Dumps a function as a binary chunk.
 	 \details Receives a Lua function on the top
 	 of the stack and produces a binary chunk
 	 that, if loaded again, results in a function
-	 equivalent to the one dumped.
+	 equivalent to the one dumped. The binary chunk is
+	 pushed onto the stack as a string.
 	 \param outlen length of the returned binary chunk
-	 \return binary chunk representing the Lua function
+	 \param strip remove debug information from the chunk
+	 \return binary chunk representing the Lua function,
+	 nullptr if it couldn't be dumped
 	 */
 	const char *Dump( size_t *outlen, bool strip = false );
 
+	/*!
+	 \brief Dumps a function as a binary chunk, streaming it
+	 to a writer.
+	 \details Receives a Lua function on the top of the stack
+	 (and leaves it there) and calls writer with successive pieces
+	 of the binary chunk, without building it in memory.
+	 The writer returns 0 on success, anything else stops the dump.
+	 \param writer function receiving the pieces of the chunk
+	 \param userdata pointer passed to every writer call
+	 \param strip remove debug information from the chunk
+	 \return 0 on success, the error code returned by the
+	 writer or 1 if the value isn't a Lua function
+	 */
+	int Dump( Writer writer, void *userdata, bool strip = false );
+
+	/*!
+	 \brief Dumps a function as a binary chunk, appending it
+	 to a byte vector.
+	 \details Receives a Lua function on the top of the stack
+	 and leaves it there.
+	 \param output vector where the chunk is appended
+	 \param strip remove debug information from the chunk
+	 \return true if the function was dumped, false otherwise
+	 */
+	bool Dump( std::vector<uint8_t> &output, bool strip = false );
+
+	/*!
+	 \brief Dumps a function as a binary chunk, writing it to
+	 a file.
+	 \details Receives a Lua function on the top of the stack
+	 and leaves it there. Not an overload of Dump, as it would
+	 make Dump( nullptr ) ambiguous.
+	 \param file file opened for writing in binary mode
+	 \param strip remove debug information from the chunk
+	 \return true if the function was dumped, false otherwise
+	 */
+	bool DumpFile( FILE *file, bool strip = false );
+
 	/*!
 	 \brief Loads and runs a buffer as a Lua chunk.
 	 \details
@@ -1219,7 +1759,15 @@ public:
 	virtual bool RunFile( const char *path, bool pcall = true );
 
 private:
-	friend static void UserstateCreated( lua_State *global, lua_State *state );
+	friend Interface &::GetLuaInterface( lua_State *state );
+
+	/*!
+	 \brief Creates the Interface object of a Lua thread.
+	 \details Called by GetLuaInterface the first time the
+	 Interface of a thread is requested. It's freed along with
+	 the thread.
+	 */
+	static Interface &CreateThreadInterface( lua_State *state );
 
 	/*!
 	 \brief Constructor.
@@ -1229,10 +1777,63 @@ private:
 	 */
 	Interface( lua_State *state, lua_State *global );
 
+	void Initialize( Library libraries, Library lazy );
+
+	Interface &GetMainInterface( );
+
+	int ObjectReferenceCreate( Interface &state );
+	void ObjectReferenceRelease( int ref );
+	void QueueReference( int ref );
+	void DrainForeignReleases( );
+
+	static int ReleaseSentinelCollected( lua_State *state );
+
+	struct ForeignRelease
+	{
+		int reference;
+		ForeignRelease *next;
+	};
+
+	struct TypeEntry
+	{
+		const void *metatable;
+		int reference;
+	};
+
+	friend Object;
+	friend StatePool;
+	friend Profiler;
+
 	lua_State *lua_state;
 	lua_State *global_state;
 
-	int pushed_scall;
+	int reference_table;
+	size_t object_count;
+	std::vector<int> released_references;
+	std::atomic<std::thread::id> owner_thread;
+	std::atomic<ForeignRelease *> foreign_releases;
+	std::mutex overflow_mutex;
+	std::condition_variable overflow_drained;
+	std::atomic<size_t> overflow_count;
+	int overflow_references[ReferenceReleaseBatch];
+	std::vector<TypeEntry> types;
+	BytecodeCache *bytecode_cache;
+	Profiler *profiler;
+	MetricCounters *metrics;
 };
 
 }
+
+inline Lua::Interface &GetLuaInterface( lua_State *state )
+{
+	Lua::Interface *lua_interface = *reinterpret_cast<Lua::Interface **>( reinterpret_cast<char *>( state ) + Lua::InterfaceOffset );
+	return lua_interface != nullptr ? *lua_interface : Lua::Interface::CreateThreadInterface( state );
+}
+
+#include <Lua/Traits.hpp>
+
+#if defined LUAINTERFACE_INLINE
+
+#include <Lua/InterfaceInline.hpp>
+
+#endif
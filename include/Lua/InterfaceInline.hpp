@@ -0,0 +1,184 @@
+#pragma once
+
+#include <lua.hpp>
+#include <Lua/Interface.hpp>
+
+namespace Lua
+{
+
+LUAINTERFACE_INLINE_API lua_State *Interface::GetLuaState( ) const
+{
+	return lua_state;
+}
+
+LUAINTERFACE_INLINE_API int Interface::GetTop( )
+{
+	return lua_gettop( lua_state );
+}
+
+LUAINTERFACE_INLINE_API void Interface::SetTop( int num )
+{
+	lua_settop( lua_state, num );
+}
+
+LUAINTERFACE_INLINE_API void Interface::Pop( int amount )
+{
+	lua_pop( lua_state, amount );
+}
+
+LUAINTERFACE_INLINE_API void Interface::CreateTable( int array_elems, int nonarray_elems )
+{
+	lua_createtable( lua_state, array_elems, nonarray_elems );
+}
+
+LUAINTERFACE_INLINE_API void Interface::GetTable( int stackpos )
+{
+	lua_gettable( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::SetTable( int stackpos )
+{
+	lua_settable( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::GetField( int stackpos, const char *strName )
+{
+	lua_getfield( lua_state, stackpos, strName );
+}
+
+LUAINTERFACE_INLINE_API void Interface::SetField( int stackpos, const char *strName )
+{
+	lua_setfield( lua_state, stackpos, strName );
+}
+
+LUAINTERFACE_INLINE_API void Interface::Insert( int stackpos )
+{
+	lua_insert( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::Remove( int stackpos )
+{
+	lua_remove( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::Replace( int stackpos )
+{
+	return lua_replace( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API int Interface::GetMetaTable( int stackpos )
+{
+	return lua_getmetatable( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API int Interface::RawEqual( int stackpos_a, int stackpos_b )
+{
+	return lua_rawequal( lua_state, stackpos_a, stackpos_b );
+}
+
+LUAINTERFACE_INLINE_API void Interface::RawGet( int stackpos )
+{
+	lua_rawget( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::RawGetI( int stackpos, int n )
+{
+	lua_rawgeti( lua_state, stackpos, n );
+}
+
+LUAINTERFACE_INLINE_API void Interface::RawSet( int stackpos )
+{
+	lua_rawset( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::RawSetI( int stackpos, int n )
+{
+	lua_rawseti( lua_state, stackpos, n );
+}
+
+LUAINTERFACE_INLINE_API const char *Interface::ToString( int stackpos, size_t *outlen )
+{
+	return lua_tolstring( lua_state, stackpos, outlen );
+}
+
+LUAINTERFACE_INLINE_API const char *Interface::ToString( int stackpos )
+{
+	return lua_tostring( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API double Interface::ToNumber( int stackpos )
+{
+	return lua_tonumber( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API long long Interface::ToInteger( int stackpos )
+{
+	return lua_tointeger( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API bool Interface::ToBoolean( int stackpos )
+{
+	return lua_toboolean( lua_state, stackpos ) == 1;
+}
+
+LUAINTERFACE_INLINE_API void *Interface::ToUserdata( int stackpos )
+{
+	return lua_touserdata( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushValue( int stackpos )
+{
+	lua_pushvalue( lua_state, stackpos );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushNil( )
+{
+	lua_pushnil( lua_state );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushString( const char *val, size_t len )
+{
+	lua_pushlstring( lua_state, val, len );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushString( const char *val )
+{
+	lua_pushstring( lua_state, val );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushNumber( double val )
+{
+	lua_pushnumber( lua_state, val );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushInteger( long long val )
+{
+	lua_pushinteger( lua_state, val );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushBoolean( bool val )
+{
+	lua_pushboolean( lua_state, val );
+}
+
+LUAINTERFACE_INLINE_API void Interface::PushLightUserdata( void *val )
+{
+	lua_pushlightuserdata( lua_state, val );
+}
+
+LUAINTERFACE_INLINE_API int Interface::UpvalueIndex( int index )
+{
+	return lua_upvalueindex( index );
+}
+
+LUAINTERFACE_INLINE_API Type Interface::GetType( int stackpos )
+{
+	return static_cast<Type>( lua_type( lua_state, stackpos ) );
+}
+
+LUAINTERFACE_INLINE_API bool Interface::IsType( int stackpos, Type type )
+{
+	return GetType( stackpos ) == type;
+}
+
+}
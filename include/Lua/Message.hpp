@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+#include <vector>
+
+namespace Lua
+{
+
+class Interface;
+class TypeTag;
+
+/*!
+ \brief A Lua value serialized into a flat buffer, to pass it
+ between Lua states.
+ \details A message is encoded from a value of one Interface and
+ can be decoded into any other (or the same one), on any thread,
+ as long as they're in the same process. Nil, booleans, numbers,
+ strings (and string views, which are decoded as strings), light
+ userdata and tables are supported, as well as userdata of types
+ registered with RegisterType. Tables are encoded with their keys
+ and values but without their metatables; tables referenced more
+ than once (including cycles) and repeated strings are encoded
+ once, so the decoded graph has the same shape as the original.
+ Functions and threads can't be encoded.
+ */
+class LUAINTERFACE_API Message
+{
+public:
+	/*!
+	 \brief Appends the contents of the userdata at stackpos to
+	 output. It must leave the stack as it found it.
+	 */
+	typedef void ( *Encoder )( Interface &lua, int stackpos, std::vector<uint8_t> &output );
+
+	/*!
+	 \brief Pushes a userdata rebuilt from the contents appended
+	 by the Encoder of its type.
+	 */
+	typedef void ( *Decoder )( Interface &lua, const uint8_t *data, size_t size );
+
+	/*!
+	 \brief Constructor for an empty message.
+	 */
+	Message( );
+
+	/*!
+	 \brief Constructor for a message from the buffer of another
+	 message.
+	 \details Useful to move messages through byte queues.
+	 \sa GetData()
+	 \param data buffer of an encoded message
+	 \param size size in bytes of the buffer
+	 */
+	Message( const void *data, size_t size );
+
+	/*!
+	 \brief Encodes the value at stackpos, replacing the current
+	 contents of the message.
+	 \details Traverses the value graph once, without calling
+	 metamethods. The stack is left untouched.
+	 \param lua Interface holding the value
+	 \param stackpos stack index of the value
+	 \return true if the value was encoded, false if the graph has
+	 a value that can't be encoded (the message is left empty)
+	 */
+	bool Encode( Interface &lua, int stackpos );
+
+	/*!
+	 \brief Pushes the value encoded in the message.
+	 \param lua Interface where the value is pushed
+	 \return true if the value was pushed, false if the message is
+	 empty or malformed (nothing is pushed)
+	 */
+	bool Decode( Interface &lua ) const;
+
+	/*!
+	 \brief Returns whether the message has no value encoded.
+	 */
+	bool IsEmpty( ) const;
+
+	/*!
+	 \brief Returns the buffer of the message.
+	 */
+	const uint8_t *GetData( ) const;
+
+	/*!
+	 \brief Returns the size in bytes of the buffer of the message.
+	 */
+	size_t GetSize( ) const;
+
+	/*!
+	 \brief Allows encoding userdata of the type tag.
+	 \details Registered types are shared by every Interface of the
+	 process. Meant to be called at startup, before encoding or
+	 decoding messages with userdata of the type.
+	 \param tag userdata type
+	 \param encoder function appending the contents of a userdata
+	 \param decoder function pushing a userdata from its contents
+	 */
+	static void RegisterType( const TypeTag &tag, Encoder encoder, Decoder decoder );
+
+private:
+	std::vector<uint8_t> buffer;
+};
+
+}
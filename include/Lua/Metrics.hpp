@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+
+namespace Lua
+{
+
+/*!
+ \brief Snapshot of the runtime counters of a Lua state.
+ \details Counters start at zero when the Interface is created and
+ only grow, so the difference between two snapshots gives the
+ activity in between.
+ \sa Interface::GetMetrics()
+ */
+struct Metrics
+{
+	/*!
+	 \brief Bytes requested from the allocator, reallocations
+	 included.
+	 */
+	uint64_t bytes_allocated;
+
+	/*!
+	 \brief Bytes given back to the allocator, reallocations
+	 included.
+	 \details bytes_allocated - bytes_freed is the memory in use
+	 by the Lua state, not counting what was allocated while
+	 the state was being created.
+	 */
+	uint64_t bytes_freed;
+
+	/*!
+	 \brief Garbage collection cycles completed.
+	 */
+	uint64_t gc_cycles;
+
+	/*!
+	 \brief Nanoseconds spent in the garbage collector, finalizers
+	 included.
+	 \details Only measured with the bundled Lua 5.3, it's always
+	 zero with LuaJIT.
+	 */
+	uint64_t gc_time;
+
+	/*!
+	 \brief Calls made through Interface::PCall, on any thread.
+	 */
+	uint64_t pcalls;
+
+	/*!
+	 \brief Calls made through Interface::PCall that returned an
+	 error.
+	 */
+	uint64_t errors;
+
+	/*!
+	 \brief Largest stack size, in slots, seen when a call made
+	 through Interface::PCall returned.
+	 \details It's the allocated size of the stack, so it's an
+	 upper bound of the stack depth reached by the call.
+	 */
+	uint64_t peak_stack;
+};
+
+}
@@ -1,23 +1,73 @@
 #pragma once
 
 #include <Lua/Config.hpp>
-#include <memory>
 
 namespace Lua
 {
 
 class Interface;
-class Reference;
 
+/*!
+ \brief Handle to a Lua value kept alive from C++.
+ \details Holds a single reference on the Lua state that created it.
+ Moving is free, copying creates a new reference. Released references
+ are freed in batches by the Interface (see Interface::FlushReferences).
+ Objects must be created and copied on the thread that owns the
+ Lua state, but may be destroyed on any thread (see
+ Interface::SetOwnerThread). They must not outlive the Lua state.
+ */
 class LUAINTERFACE_API Object
 {
 public:
+	/*!
+	 \brief Constructs an invalid object.
+	 */
+	Object( );
 
+	/*!
+	 \brief Copy constructor.
+	 \details Creates a new reference to the same Lua value.
+	 */
+	Object( const Object &obj );
+
+	/*!
+	 \brief Move constructor.
+	 \details Takes over the reference of obj, which becomes invalid.
+	 */
+	Object( Object &&obj );
+
+	/*!
+	 \brief Destructor. Releases the reference.
+	 */
+	~Object( );
+
+	Object &operator=( const Object &obj );
+
+	Object &operator=( Object &&obj );
+
+	/*!
+	 \brief Checks whether the object references a Lua value.
+	 \return true if the object is valid, false otherwise
+	 */
+	bool IsValid( ) const;
+
+	/*!
+	 \brief Returns the Interface of the state that owns the
+	 referenced value.
+	 \return owner Interface, nullptr for invalid objects
+	 */
+	Interface *GetLuaInterface( ) const;
+
+	/*!
+	 \brief Releases the reference, leaving the object invalid.
+	 */
+	void Release( );
 
 private:
 	Object( Interface *state, int index );
 
-	std::shared_ptr<Reference> reference;
+	Interface *lua_interface;
+	int reference;
 
 	friend Interface;
 };
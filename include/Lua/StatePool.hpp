@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Lua
+{
+
+/*!
+ \brief Keeps a set of ready to use Lua states for short-lived,
+ isolated jobs (like per-request sandboxes).
+ \details Every state is created once, set up by the bootstrap
+ callback and snapshotted. When a state is given back, it's restored
+ to that snapshot instead of being rebuilt: the stack is cleared, the
+ registry, package.loaded and the globals table are restored (as well
+ as the contents of every table in package.loaded, like string or
+ math, and the metatables shared by basic types, like the one of
+ strings, with their __index tables), and anything added since is
+ removed. The collector settings (running or stopped, pause and step
+ multiplier) and the hook of the state are put back too, and the
+ profiler is stopped. The restore is shallow
+ past that point: tables created by the bootstrap callback and
+ modified by a job keep the modifications.
+ States are kept in per-thread shards, so acquiring and releasing
+ from many threads at once rarely contends.
+ */
+class LUAINTERFACE_API StatePool
+{
+	struct Entry;
+
+public:
+	/*!
+	 \brief Callback that sets up every new state of the pool.
+	 */
+	typedef std::function<void ( Interface & )> Bootstrap;
+
+	/*!
+	 \brief Scoped ownership of a state from the pool.
+	 \details Gives the state back to the pool when destroyed.
+	 */
+	class LUAINTERFACE_API Handle
+	{
+	public:
+		/*!
+		 \brief Constructs an empty handle.
+		 */
+		Handle( );
+
+		Handle( Handle &&handle );
+
+		/*!
+		 \brief Destructor. Gives the state back to the pool.
+		 \details Every Object created from the state must have been
+		 destroyed before, otherwise the state is destroyed instead of
+		 being restored.
+		 */
+		~Handle( );
+
+		Handle &operator=( Handle &&handle );
+
+		/*!
+		 \brief Returns the state held by the handle.
+		 \return the state, or nullptr for empty handles
+		 */
+		Interface *Get( ) const;
+
+		Interface &operator*( ) const;
+
+		Interface *operator->( ) const;
+
+		/*!
+		 \brief Gives the state back to the pool early, leaving
+		 the handle empty.
+		 */
+		void Release( );
+
+	private:
+		Handle( const Handle & );
+		Handle &operator=( const Handle & );
+
+		Handle( StatePool *pool, Entry *entry );
+
+		StatePool *pool;
+		Entry *entry;
+
+		friend StatePool;
+	};
+
+	/*!
+	 \brief Constructor. Creates count states up front.
+	 \details Exceptions thrown by bootstrap are propagated.
+	 \param count number of states created up front
+	 \param bootstrap callback run once on every new state, before
+	 it's snapshotted
+	 */
+	explicit StatePool( size_t count, Bootstrap bootstrap = Bootstrap( ) );
+
+	/*!
+	 \brief Destructor. Destroys every idle state.
+	 \details Every Handle must have been released before.
+	 */
+	~StatePool( );
+
+	/*!
+	 \brief Takes an idle state from the pool, creating a new one
+	 if there's none.
+	 \details The calling thread becomes the owner of the state
+	 (see Interface::SetOwnerThread).
+	 \return handle to the state
+	 */
+	Handle Acquire( );
+
+	/*!
+	 \brief Returns the number of idle states in the pool.
+	 \return number of idle states
+	 */
+	size_t GetIdleCount( ) const;
+
+private:
+	StatePool( const StatePool & );
+	StatePool &operator=( const StatePool & );
+
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::vector<Entry *> idle;
+
+		// Keeps shards on different cache lines
+		char padding[64];
+	};
+
+	Entry *Create( );
+	void Release( Entry *entry );
+	Shard &GetShard( );
+
+	Bootstrap bootstrap;
+	std::unique_ptr<Shard[]> shards;
+	size_t shard_count;
+};
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+
+namespace Lua
+{
+
+/*!
+ \brief Builds Lua strings piece by piece.
+ \details Meant to live on the C++ stack. Strings up to BufferSize
+ bytes are built in internal storage without touching the heap. Bigger
+ strings spill into a Lua userdata placed on the stack, which is owned
+ by the garbage collector, so nothing leaks if a Lua error interrupts
+ the building. While the builder holds a spilled userdata, the stack
+ must be kept balanced between calls, like with luaL_Buffer.
+ */
+class LUAINTERFACE_API StringBuilder
+{
+public:
+	/*!
+	 \brief Constructor.
+	 \param lua Interface where the resulting string will be pushed
+	 */
+	explicit StringBuilder( Interface &lua );
+
+	/*!
+	 \brief Makes sure size more bytes can be added without
+	 growing the storage again.
+	 \param size number of bytes to reserve
+	 */
+	void Reserve( size_t size );
+
+	/*!
+	 \brief Returns a pointer to at least size writable bytes
+	 at the end of the string.
+	 \details Call Commit with the number of bytes actually
+	 written. The pointer is invalidated by any other call.
+	 \param size number of bytes to make available
+	 \return pointer to the writable area
+	 */
+	char *Prepare( size_t size );
+
+	/*!
+	 \brief Adds to the string size bytes previously written to
+	 the area returned by Prepare.
+	 \param size number of bytes written
+	 */
+	void Commit( size_t size );
+
+	/*!
+	 \brief Adds the string pointed to by str with length len.
+	 \details The string may contain embedded zeros.
+	 \param str string to be copied
+	 \param len length of the string
+	 */
+	void AddString( const char *str, size_t len );
+
+	/*!
+	 \brief Adds the zero-terminated string pointed to by str.
+	 \param str string to be copied
+	 \sa AddString()
+	 \overload
+	 */
+	void AddString( const char *str );
+
+	/*!
+	 \brief Adds the character ch.
+	 \param ch character to be added
+	 */
+	void AddChar( char ch );
+
+	/*!
+	 \brief Adds the textual representation of a number, formatted
+	 like Lua's tostring.
+	 \param number number to be added
+	 */
+	void AddNumber( double number );
+
+	/*!
+	 \brief Adds the textual representation of an integer.
+	 \param number integer to be added
+	 */
+	void AddInteger( long long number );
+
+	/*!
+	 \brief Adds the string or number at the top of the stack
+	 and pops it.
+	 */
+	void AddValue( );
+
+	/*!
+	 \brief Returns the number of bytes added so far.
+	 \return length of the string being built
+	 */
+	size_t Size( ) const;
+
+	/*!
+	 \brief Returns the string built so far.
+	 \details Not zero-terminated.
+	 \return pointer to the string being built
+	 */
+	const char *Data( ) const;
+
+	/*!
+	 \brief Pushes the resulting string onto the stack and
+	 resets the builder.
+	 \param outlen length of the resulting string
+	 \return resulting string
+	 */
+	const char *Finish( size_t *outlen = nullptr );
+
+private:
+	StringBuilder( const StringBuilder & );
+	StringBuilder &operator=( const StringBuilder & );
+
+	void Grow( size_t size );
+
+	Interface &lua;
+	char *data;
+	size_t size;
+	size_t capacity;
+	int box;
+	char storage[BufferSize];
+};
+
+}
@@ -0,0 +1,87 @@
+#ifndef LUAINTERFACE_STRINGVIEW_H
+#define LUAINTERFACE_STRINGVIEW_H
+
+/*
+ * Layout of the string view userdata pushed by Lua::Interface::PushStringView,
+ * usable from C modules (like luasocket) to accept views wherever they accept
+ * strings, without copying them.
+ * The data pointer is only valid while the view is reachable from Lua, like
+ * with strings, and is NULL (with len 0) once the view has been released.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+#if defined _MSC_VER && !defined __cplusplus
+
+#define LUAINTERFACE_STRINGVIEW_INLINE static __inline
+
+#else
+
+#define LUAINTERFACE_STRINGVIEW_INLINE static inline
+
+#endif
+
+/* Name of the string view metatable in the registry */
+#define LUAINTERFACE_STRINGVIEW "LuaInterface.StringView"
+
+typedef void ( *luainterface_stringview_release )( const char *data, size_t len, void *userdata );
+
+typedef struct luainterface_stringview
+{
+	const char *data;
+	size_t len;
+	luainterface_stringview_release release;
+	void *userdata;
+} luainterface_stringview;
+
+/* Returns the contents of the string or string view at idx, or NULL for any other value */
+LUAINTERFACE_STRINGVIEW_INLINE const char *luainterface_tostringview( lua_State *L, int idx, size_t *len )
+{
+	luainterface_stringview *view;
+	int same;
+
+	if( lua_type( L, idx ) == LUA_TSTRING )
+		return lua_tolstring( L, idx, len );
+
+	view = ( luainterface_stringview * )lua_touserdata( L, idx );
+	if( view == NULL || !lua_getmetatable( L, idx ) )
+		return NULL;
+
+	luaL_getmetatable( L, LUAINTERFACE_STRINGVIEW );
+	same = lua_rawequal( L, -1, -2 );
+	lua_pop( L, 2 );
+	if( !same )
+		return NULL;
+
+	if( len != NULL )
+		*len = view->len;
+
+	/* Released views are empty */
+	return view->data != NULL ? view->data : "";
+}
+
+/* Like luaL_checklstring, but also accepts string views */
+LUAINTERFACE_STRINGVIEW_INLINE const char *luainterface_checkstringview( lua_State *L, int idx, size_t *len )
+{
+	const char *data = luainterface_tostringview( L, idx, len );
+	return data != NULL ? data : luaL_checklstring( L, idx, len );
+}
+
+/* Like luaL_optlstring, but also accepts string views */
+LUAINTERFACE_STRINGVIEW_INLINE const char *luainterface_optstringview( lua_State *L, int idx, const char *def, size_t *len )
+{
+	if( lua_isnoneornil( L, idx ) )
+	{
+		if( len != NULL )
+			*len = def != NULL ? strlen( def ) : 0;
+
+		return def;
+	}
+
+	return luainterface_checkstringview( L, idx, len );
+}
+
+#endif
@@ -0,0 +1,448 @@
+#pragma once
+
+#include <Lua/Interface.hpp>
+#include <string>
+#include <type_traits>
+#include <limits>
+#include <cmath>
+
+namespace Lua
+{
+
+/*!
+ \brief Converts C++ values to Lua values and back.
+ \details Used by SCall and SPCall to push arguments and read results.
+ A specialization provides static Push( Interface &, const T & ),
+ static T Get( Interface &, int stackpos ) and/or
+ static T Check( Interface &, int stackpos ) members. Check is used for
+ the arguments of bound functions (see Class) and raises a Lua error
+ when the value can't be converted. Specializations for
+ your own types may be added to the Lua namespace, for example:
+
+ \code
+ namespace Lua
+ {
+ template<> struct Traits<Vector>
+ {
+ 	static void Push( Interface &lua, const Vector &value )
+ 	{
+ 		lua.CreateTable( 0, 2 );
+ 		lua.PushNumber( value.x );
+ 		lua.SetField( -2, "x" );
+ 		lua.PushNumber( value.y );
+ 		lua.SetField( -2, "y" );
+ 	}
+ };
+ }
+ \endcode
+
+ The second template parameter allows enabling a specialization for a
+ whole family of types with std::enable_if.
+ */
+template<>
+struct Traits<std::nullptr_t>
+{
+	static void Push( Interface &lua, std::nullptr_t )
+	{
+		lua.PushNil( );
+	}
+};
+
+template<>
+struct Traits<bool>
+{
+	static void Push( Interface &lua, bool value )
+	{
+		lua.PushBoolean( value );
+	}
+
+	static bool Get( Interface &lua, int stackpos )
+	{
+		return lua.ToBoolean( stackpos );
+	}
+
+	static bool Check( Interface &lua, int stackpos )
+	{
+		return lua.ToBoolean( stackpos );
+	}
+};
+
+template<typename T>
+struct Traits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+	static void Push( Interface &lua, T value )
+	{
+		lua.PushInteger( static_cast<long long>( value ) );
+	}
+
+	static T Get( Interface &lua, int stackpos )
+	{
+		return static_cast<T>( lua.ToInteger( stackpos ) );
+	}
+
+	static T Check( Interface &lua, int stackpos )
+	{
+		return static_cast<T>( lua.CheckInteger( stackpos ) );
+	}
+};
+
+template<typename T>
+struct Traits<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+	static void Push( Interface &lua, T value )
+	{
+		lua.PushNumber( static_cast<double>( value ) );
+	}
+
+	static T Get( Interface &lua, int stackpos )
+	{
+		return static_cast<T>( lua.ToNumber( stackpos ) );
+	}
+
+	static T Check( Interface &lua, int stackpos )
+	{
+		return static_cast<T>( lua.CheckNumber( stackpos ) );
+	}
+};
+
+/*!
+ \brief Strings can't be read as const char * results, since the
+ pointer would not outlive the Lua value. Use std::string to
+ read them. Arguments of bound functions are fine, as they stay
+ on the stack during the call.
+ */
+template<>
+struct Traits<const char *>
+{
+	static void Push( Interface &lua, const char *value )
+	{
+		lua.PushString( value );
+	}
+
+	static const char *Check( Interface &lua, int stackpos )
+	{
+		return lua.CheckString( stackpos );
+	}
+};
+
+template<>
+struct Traits<char *> : Traits<const char *>
+{ };
+
+template<size_t Size>
+struct Traits<char [Size]>
+{
+	static void Push( Interface &lua, const char *value )
+	{
+		lua.PushString( value );
+	}
+};
+
+template<>
+struct Traits<std::string>
+{
+	static void Push( Interface &lua, const std::string &value )
+	{
+		lua.PushString( value.data( ), value.size( ) );
+	}
+
+	static std::string Get( Interface &lua, int stackpos )
+	{
+		size_t len = 0;
+		const char *str = lua.ToString( stackpos, &len );
+		return str != nullptr ? std::string( str, len ) : std::string( );
+	}
+
+	static std::string Check( Interface &lua, int stackpos )
+	{
+		size_t len = 0;
+		const char *str = lua.CheckString( stackpos, &len );
+		return std::string( str, len );
+	}
+};
+
+template<>
+struct Traits<Function>
+{
+	static void Push( Interface &lua, Function value )
+	{
+		lua.PushFunction( value );
+	}
+
+	static Function Get( Interface &lua, int stackpos )
+	{
+		return lua.ToFunction( stackpos );
+	}
+};
+
+template<>
+struct Traits<lua_State *>
+{
+	static void Push( Interface &lua, lua_State *value )
+	{
+		lua.PushThread( value );
+	}
+};
+
+template<>
+struct Traits<Object>
+{
+	static void Push( Interface &lua, const Object &value )
+	{
+		lua.PushObject( value );
+	}
+
+	static Object Get( Interface &lua, int stackpos )
+	{
+		return lua.ToObject( stackpos );
+	}
+
+	static Object Check( Interface &lua, int stackpos )
+	{
+		lua.CheckAny( stackpos );
+		return lua.ToObject( stackpos );
+	}
+};
+
+namespace Internal
+{
+
+template<size_t... Indices>
+struct IndexSequence
+{ };
+
+template<size_t Count, size_t... Indices>
+struct MakeIndexSequence : MakeIndexSequence<Count - 1, Count - 1, Indices...>
+{ };
+
+template<size_t... Indices>
+struct MakeIndexSequence<0, Indices...>
+{
+	typedef IndexSequence<Indices...> Type;
+};
+
+// Decayed, so functions are pushed as function pointers and arrays as pointers
+template<typename... Args>
+inline void PushArguments( Interface &lua, const Args &... args )
+{
+	int pushed[] = { 0, ( Traits<typename std::decay<Args>::type>::Push( lua, args ), 0 )... };
+	static_cast<void>( pushed );
+}
+
+template<typename... Results, size_t... Indices>
+inline std::tuple<Results...> GetResults( Interface &lua, IndexSequence<Indices...> )
+{
+	int base = lua.GetTop( ) - static_cast<int>( sizeof...( Results ) ) + 1;
+	static_cast<void>( base );
+	std::tuple<Results...> results( Traits<Results>::Get( lua, base + static_cast<int>( Indices ) )... );
+	lua.Pop( static_cast<int>( sizeof...( Results ) ) );
+	return results;
+}
+
+}
+
+namespace Internal
+{
+
+inline int AbsoluteIndex( Interface &lua, int stackpos )
+{
+	return stackpos < 0 && -stackpos <= lua.GetTop( ) ? lua.GetTop( ) + stackpos + 1 : stackpos;
+}
+
+// Arrays of types without a bulk version are converted one by one
+template<typename Type, typename Enable = void>
+struct ArrayConverter
+{
+	static size_t Read( Interface &lua, int stackpos, Type *values, size_t count )
+	{
+		stackpos = AbsoluteIndex( lua, stackpos );
+		for( size_t k = 0; k < count; ++k )
+		{
+			lua.RawGetI( stackpos, static_cast<int>( k + 1 ) );
+			values[k] = Traits<Type>::Get( lua, -1 );
+			lua.Pop( 1 );
+		}
+
+		return count;
+	}
+
+	static void Push( Interface &lua, const Type *values, size_t count )
+	{
+		lua.CreateTable( static_cast<int>( count ), 0 );
+		for( size_t k = 0; k < count; ++k )
+		{
+			Traits<Type>::Push( lua, values[k] );
+			lua.RawSetI( -2, static_cast<int>( k + 1 ) );
+		}
+	}
+};
+
+// Arithmetic types go through the double or long long bulk versions,
+// in chunks when they have to be converted
+template<typename Type>
+struct ArrayConverter<Type, typename std::enable_if<std::is_arithmetic<Type>::value && !std::is_same<Type, bool>::value>::type>
+{
+	typedef typename std::conditional<std::is_floating_point<Type>::value, double, long long>::type Number;
+
+	static const size_t ChunkSize = 256;
+
+	static size_t Read( Interface &lua, int stackpos, Type *values, size_t count )
+	{
+		return Read( lua, stackpos, values, count, std::is_same<Type, Number>( ) );
+	}
+
+	static size_t Read( Interface &lua, int stackpos, Number *values, size_t count, std::true_type )
+	{
+		return lua.ReadArray( stackpos, values, count );
+	}
+
+	static size_t Read( Interface &lua, int stackpos, Type *values, size_t count, std::false_type )
+	{
+		Number chunk[ChunkSize];
+		size_t read = 0;
+		while( read < count )
+		{
+			size_t size = count - read < ChunkSize ? count - read : ChunkSize;
+			size_t chunk_read = lua.ReadArray( stackpos, chunk, size, read );
+			for( size_t k = 0; k < chunk_read; ++k )
+			{
+				if( !Fits( chunk[k] ) )
+					return read + k;
+
+				values[read + k] = static_cast<Type>( chunk[k] );
+			}
+
+			read += chunk_read;
+			if( chunk_read != size )
+				break;
+		}
+
+		return read;
+	}
+
+	// Whether a number is in the range of Type (integers converted back
+	// and forth keep their value, and their sign for unsigned types)
+	static bool Fits( long long value )
+	{
+		return static_cast<long long>( static_cast<Type>( value ) ) == value && ( std::is_signed<Type>::value || value >= 0 );
+	}
+
+	// Infinities and NaN convert to any floating point type
+	static bool Fits( double value )
+	{
+		double magnitude = std::fabs( value );
+		return !( magnitude > std::numeric_limits<Type>::max( ) ) || magnitude == std::numeric_limits<double>::infinity( );
+	}
+
+	static void Push( Interface &lua, const Type *values, size_t count )
+	{
+		Push( lua, values, count, std::is_same<Type, Number>( ) );
+	}
+
+	static void Push( Interface &lua, const Number *values, size_t count, std::true_type )
+	{
+		lua.PushArray( values, count );
+	}
+
+	static void Push( Interface &lua, const Type *values, size_t count, std::false_type )
+	{
+		lua.CreateTable( static_cast<int>( count ), 0 );
+		Number chunk[ChunkSize];
+		for( size_t written = 0; written < count; written += ChunkSize )
+		{
+			size_t size = count - written < ChunkSize ? count - written : ChunkSize;
+			for( size_t k = 0; k < size; ++k )
+				chunk[k] = static_cast<Number>( values[written + k] );
+
+			lua.WriteArray( -1, chunk, size, written );
+		}
+	}
+};
+
+}
+
+template<typename Type>
+bool Interface::ReadArray( int stackpos, std::vector<Type> &values )
+{
+	if( !IsType( stackpos, Lua::Type::Table ) )
+	{
+		values.clear( );
+		return false;
+	}
+
+	values.resize( RawLen( stackpos ) );
+	size_t read = Internal::ArrayConverter<Type>::Read( *this, stackpos, values.data( ), values.size( ) );
+	if( read == values.size( ) )
+		return true;
+
+	values.resize( read );
+	return false;
+}
+
+template<typename Type>
+void Interface::PushArray( const Type *values, size_t count )
+{
+	Internal::ArrayConverter<Type>::Push( *this, values, count );
+}
+
+template<typename Type>
+void Interface::PushArray( const std::vector<Type> &values )
+{
+	Internal::ArrayConverter<Type>::Push( *this, values.data( ), values.size( ) );
+}
+
+template<typename Map>
+bool Interface::ReadMap( int stackpos, Map &map )
+{
+	map.clear( );
+	if( !IsType( stackpos, Lua::Type::Table ) )
+		return false;
+
+	stackpos = Internal::AbsoluteIndex( *this, stackpos );
+	PushNil( );
+	while( Next( stackpos ) != 0 )
+	{
+		// Keys are read from a copy, converting them in place would break Next
+		PushValue( -2 );
+		map.insert( typename Map::value_type(
+			Traits<typename Map::key_type>::Get( *this, -1 ),
+			Traits<typename Map::mapped_type>::Get( *this, -2 )
+		) );
+		Pop( 2 );
+	}
+
+	return true;
+}
+
+template<typename Map>
+void Interface::PushMap( const Map &map )
+{
+	CreateTable( 0, static_cast<int>( map.size( ) ) );
+	for( typename Map::const_iterator it = map.begin( ); it != map.end( ); ++it )
+	{
+		Traits<typename Map::key_type>::Push( *this, it->first );
+		Traits<typename Map::mapped_type>::Push( *this, it->second );
+		RawSet( -3 );
+	}
+}
+
+template<typename... Results, typename... Args>
+std::tuple<Results...> Interface::SCall( const Args &... args )
+{
+	Internal::PushArguments( *this, args... );
+	Call( static_cast<int>( sizeof...( Args ) ), static_cast<int>( sizeof...( Results ) ) );
+	return Internal::GetResults<Results...>( *this, typename Internal::MakeIndexSequence<sizeof...( Results )>::Type( ) );
+}
+
+template<typename... Results, typename... Args>
+bool Interface::SPCall( std::tuple<Results...> &results, const Args &... args )
+{
+	Internal::PushArguments( *this, args... );
+	if( PCall( static_cast<int>( sizeof...( Args ) ), static_cast<int>( sizeof...( Results ) ) ) != 0 )
+		return false;
+
+	results = Internal::GetResults<Results...>( *this, typename Internal::MakeIndexSequence<sizeof...( Results )>::Type( ) );
+	return true;
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+
+namespace Lua
+{
+
+/*!
+ \brief Identifies a userdata type.
+ \details Meant to be a static object, one per userdata type. Each
+ tag gets a process-wide unique integer when constructed. Once a
+ metatable is registered for a tag with Interface::NewMetatable,
+ checking a userdata against the tag (see Interface::TestUserdata and
+ Interface::CheckUserdata) is a metatable pointer comparison, without
+ the registry lookup by name that luaL_checkudata does.
+ */
+class LUAINTERFACE_API TypeTag
+{
+public:
+	/*!
+	 \brief Constructor.
+	 \details The name is also the key of the metatable in the
+	 registry, so NewMetatable( const char * ) and friends keep
+	 working with tagged types.
+	 \param name name of the userdata type, used in error messages
+	 */
+	explicit TypeTag( const char *name );
+
+	/*!
+	 \brief Returns the name of the userdata type.
+	 \return name of the type
+	 */
+	const char *GetName( ) const;
+
+	/*!
+	 \brief Returns the unique integer of this tag.
+	 \return unique identifier of the type
+	 */
+	size_t GetID( ) const;
+
+private:
+	TypeTag( const TypeTag & );
+	TypeTag &operator=( const TypeTag & );
+
+	const char *name;
+	size_t id;
+};
+
+}
@@ -54,10 +54,49 @@
 
 #if defined(__cplusplus) && !defined(LUA_USE_LONGJMP)	/* { */
 
-/* C++ exceptions */
+/*
+** C++ exceptions. Lua errors throw the lua_longjmp they jump to; any
+** other exception (like the ones thrown by C++ functions) is turned
+** into a regular error, see 'catchforeign'. Both unwind the same way
+** and a protected call costs no more than a try block when nothing
+** is thrown.
+*/
+#include <exception>
+#include <new>
+
+static void raiseforeign (lua_State *L, void *ud) {
+  luaO_pushfstring(L, "%s", (const char *)ud);
+  luaG_errormsg(L);  /* call the message handler, like any error */
+}
+
+/*
+** Turns the C++ exception being handled into a runtime error with its
+** message on the top of the stack, returning the error code
+*/
+static int catchforeign (lua_State *L) {
+  const char *msg = "unknown C++ exception";
+  try {
+    throw;
+  }
+  catch (const std::bad_alloc &) {
+    return LUA_ERRMEM;
+  }
+  catch (const std::exception &e) {
+    msg = e.what();
+  }
+  catch (const char *s) {
+    msg = s;
+  }
+  catch (...) {
+  }
+  return luaD_rawrunprotected(L, raiseforeign, (void *)msg);
+}
+
 #define LUAI_THROW(L,c)		throw(c)
 #define LUAI_TRY(L,c,a) \
-	try { a } catch(...) { if ((c)->status == 0) (c)->status = -1; }
+	try { a } \
+	catch(struct lua_longjmp *) { if ((c)->status == 0) (c)->status = -1; } \
+	catch(...) { (c)->status = catchforeign(L); }
 #define luai_jmpbuf		int  /* dummy variable */
 
 #elif defined(LUA_USE_POSIX)				/* }{ */
@@ -253,6 +253,18 @@ typedef unsigned long Instruction;
 #define luai_userstateyield(L,n)	((void)L)
 #endif
 
+/*
+** these macros allow user-specific actions when the garbage collector
+** starts and finishes doing work.
+*/
+#if !defined(luai_userstategcbegin)
+#define luai_userstategcbegin(L)	((void)L)
+#endif
+
+#if !defined(luai_userstategcend)
+#define luai_userstategcend(L)		((void)L)
+#endif
+
 
 
 /*
@@ -66,6 +66,7 @@ static const int CLIBS = 0;
 
 extern const char *luai_moduleloadfunc;
 extern const char *luai_moduleunloadfunc;
+int luai_reloadlib (lua_State *L, const char *path, const char *sym, int nargs);
 #define setprogdir(L)           ((void)0)
 
 
@@ -107,6 +108,7 @@ static lua_CFunction lsys_sym (lua_State *L, void *lib, const char *sym);
 */
 
 #include <dlfcn.h>
+#include <unistd.h>
 
 /*
 ** Macro to convert pointer-to-void* to pointer-to-function. This cast
@@ -342,18 +344,28 @@ static void addtoclib (lua_State *L, const char *path, void *plib) {
 
 /*
 ** __gc tag method for CLIBS table: calls 'lsys_unloadlib' for all lib
-** handles in list CLIBS
+** handles in list CLIBS (and their unload functions, unless they were
+** called already when the library was reloaded)
 */
 static int gctm (lua_State *L) {
   lua_Integer n = luaL_len(L, 1);
+  lua_rawgetp(L, 1, &CLIBS);  /* set of reloaded handles (or nil) */
   for (; n >= 1; n--) {  /* for each handle, in reverse order */
     void *ud = NULL;
+    int reloaded = 0;
     lua_rawgeti(L, 1, n);  /* get handle CLIBS[n] */
     ud = lua_touserdata(L, -1);
-    lua_CFunction f = lsys_sym(L, ud, luai_moduleunloadfunc);
-    if (f != NULL) f(L);
+    if (lua_istable(L, 2)) {
+      lua_pushvalue(L, -1);
+      reloaded = lua_rawget(L, 2) != LUA_TNIL;
+      lua_pop(L, 1);
+    }
+    if (!reloaded) {
+      lua_CFunction f = lsys_sym(L, ud, luai_moduleunloadfunc);
+      if (f != NULL) f(L);
+    }
     lsys_unloadlib(ud);
-    lua_pop(L, 1);  /* pop handle */
+    lua_settop(L, 2);  /* pop handle (and error message of 'lsys_sym') */
   }
   return 0;
 }
@@ -399,6 +411,222 @@ static int lookforfunc (lua_State *L, const char *path, const char *sym) {
 }
 
 
+#if defined(__ELF__)
+
+#include <elf.h>
+
+#if defined(__LP64__)
+#define ELF_CLASS	ELFCLASS64
+typedef Elf64_Ehdr Elf_Ehdr;
+typedef Elf64_Phdr Elf_Phdr;
+#else
+#define ELF_CLASS	ELFCLASS32
+typedef Elf32_Ehdr Elf_Ehdr;
+typedef Elf32_Phdr Elf_Phdr;
+#endif
+
+/*
+** Checks that the segments and the section headers of the ELF library
+** in 'f' are within the file, since the dynamic loader crashes on
+** truncated libraries (like a new build still being written).
+*/
+static int elfcomplete (FILE *f) {
+  Elf_Ehdr eh;
+  Elf_Phdr ph;
+  unsigned long end, size;
+  int i;
+  if (fseek(f, 0, SEEK_END) != 0) return 0;
+  size = (unsigned long)ftell(f);
+  rewind(f);
+  if (fread(&eh, sizeof(eh), 1, f) != 1)
+    return 0;
+  if (memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 ||
+      eh.e_ident[EI_CLASS] != ELF_CLASS) {
+    rewind(f);
+    return 1;  /* not a native ELF library; let the loader report it */
+  }
+  end = (unsigned long)eh.e_shoff + (unsigned long)eh.e_shnum * eh.e_shentsize;
+  for (i = 0; i < eh.e_phnum && end <= size; i++) {
+    unsigned long off = (unsigned long)eh.e_phoff + (unsigned long)i * eh.e_phentsize;
+    if (off > size || fseek(f, (long)off, SEEK_SET) != 0 ||
+        fread(&ph, sizeof(ph), 1, f) != 1)
+      return 0;
+    if ((unsigned long)ph.p_offset + ph.p_filesz > end)
+      end = (unsigned long)ph.p_offset + ph.p_filesz;
+  }
+  rewind(f);
+  return end <= size;
+}
+
+#else
+#define elfcomplete(f)	(rewind(f), 1)
+#endif
+
+
+/*
+** Creates a new temporary file and pushes its name. Returns the file
+** open for writing, or NULL and an error message in the stack.
+*/
+static FILE *opentmp (lua_State *L) {
+#if defined(LUA_DL_DLL)
+  char dir[MAX_PATH + 1];
+  char name[MAX_PATH + 1];
+  if (GetTempPathA(sizeof(dir), dir) != 0 &&
+      GetTempFileNameA(dir, "lua", 0, name) != 0) {
+    FILE *f = fopen(name, "wb");
+    if (f != NULL) {
+      lua_pushstring(L, name);
+      return f;
+    }
+    remove(name);
+  }
+#elif defined(LUA_USE_DLOPEN)
+  const char *dir = getenv("TMPDIR");
+  const char *model;
+  char *name;
+  int fd;
+  if (dir == NULL || *dir == '\0') dir = "/tmp";
+  model = lua_pushfstring(L, "%s/lua_reload_XXXXXX", dir);
+  name = (char *)lua_newuserdata(L, strlen(model) + 1);
+  strcpy(name, model);
+  fd = mkstemp(name);
+  if (fd != -1) {
+    FILE *f = fdopen(fd, "wb");
+    if (f != NULL) {
+      lua_pop(L, 2);
+      lua_pushstring(L, name);
+      return f;
+    }
+    close(fd);
+    remove(name);
+  }
+  lua_pop(L, 2);
+#endif
+  lua_pushliteral(L, "cannot create a temporary file");
+  return NULL;
+}
+
+
+/*
+** Copies the library at 'path' to a new temporary file and pushes the
+** name of the copy, so it can be loaded while the library at 'path' is
+** still loaded (loaders return the same handle for the same file).
+** Returns the name, or NULL and an error message in the stack.
+*/
+static const char *copylib (lua_State *L, const char *path) {
+  char buff[BUFSIZ];
+  size_t n;
+  int ok = 1;
+  const char *copy;
+  FILE *to;
+  FILE *from = fopen(path, "rb");
+  if (from == NULL) {
+    lua_pushfstring(L, "cannot open '%s'", path);
+    return NULL;
+  }
+  if (!elfcomplete(from)) {
+    fclose(from);
+    lua_pushfstring(L, "library '%s' is incomplete", path);
+    return NULL;
+  }
+  to = opentmp(L);
+  if (to == NULL) {
+    fclose(from);
+    return NULL;
+  }
+  copy = lua_tostring(L, -1);
+  while ((n = fread(buff, 1, sizeof(buff), from)) != 0)
+    ok = ok && fwrite(buff, 1, n, to) == n;
+  ok = ok && !ferror(from);
+  fclose(from);
+  if (fclose(to) != 0 || !ok) {
+    remove(copy);
+    lua_pushfstring(L, "cannot copy '%s' to '%s'", path, copy);
+    lua_remove(L, -2);
+    return NULL;
+  }
+  return copy;
+}
+
+
+/*
+** Hot-reloads the C library loaded from 'path': loads the current file
+** at 'path' as a new library and calls its function 'sym' (or the
+** module load function) with the 'nargs' values on top of the stack.
+** Only if that succeeds, the unload function of the old library is
+** called and the new library replaces it as CLIBS[path]. The old library
+** stays loaded (in the list of CLIBS) until the state closes, since live
+** objects might still use its code (like finalizers). Returns 0 and the
+** result of 'sym' in the stack, or an error code and an error message
+** in the stack, leaving the old library untouched.
+*/
+int luai_reloadlib (lua_State *L, const char *path, const char *sym, int nargs) {
+  int base = lua_gettop(L) - nargs;
+  void *lib = checkclib(L, path);
+  void *newlib;
+  const char *copy;
+  lua_CFunction f;
+  if (lib == NULL) {
+    lua_settop(L, base);
+    lua_pushfstring(L, "library '%s' isn't loaded", path);
+    return ERRLIB;
+  }
+  copy = copylib(L, path);
+  if (copy == NULL) {
+    lua_insert(L, base + 1);  /* error message */
+    lua_settop(L, base + 1);
+    return ERRLIB;
+  }
+  newlib = lsys_load(L, copy, 0);
+  remove(copy);  /* the loaded library doesn't need its file anymore */
+  if (newlib == NULL) {
+    lua_insert(L, base + 1);  /* error message */
+    lua_settop(L, base + 1);
+    return ERRLIB;
+  }
+  lua_pop(L, 1);  /* pop name of the copy */
+  f = lsys_sym(L, newlib, sym);
+  if (f == NULL) {
+    lua_pop(L, 1);  /* error message */
+    f = lsys_sym(L, newlib, luai_moduleloadfunc);
+    if (f == NULL) {
+      lsys_unloadlib(newlib);
+      lua_insert(L, base + 1);  /* error message */
+      lua_settop(L, base + 1);
+      return ERRFUNC;
+    }
+  }
+  lua_pushcfunction(L, f);
+  lua_insert(L, base + 1);
+  if (lua_pcall(L, nargs, 1, 0) != LUA_OK) {
+    /* 'f' may have left references to the new library around, so keep
+       it loaded until the state closes (but not as CLIBS[path]) */
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &CLIBS);
+    lua_pushlightuserdata(L, newlib);
+    lua_rawseti(L, -2, luaL_len(L, -2) + 1);
+    lua_pop(L, 1);  /* pop CLIBS table; error message on top */
+    return ERRFUNC;
+  }
+  f = lsys_sym(L, lib, luai_moduleunloadfunc);
+  if (f != NULL) f(L);
+  lua_settop(L, base + 1);  /* result of 'sym' (or error of 'lsys_sym') */
+  addtoclib(L, path, newlib);
+  /* mark the old handle, so its unload function isn't called again */
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &CLIBS);
+  if (lua_rawgetp(L, -1, &CLIBS) != LUA_TTABLE) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, -3, &CLIBS);  /* CLIBS[&CLIBS] = set of reloaded handles */
+  }
+  lua_pushlightuserdata(L, lib);
+  lua_pushboolean(L, 1);
+  lua_rawset(L, -3);
+  lua_pop(L, 2);  /* pop set and CLIBS table */
+  return 0;
+}
+
+
 static int ll_loadlib (lua_State *L) {
   const char *path = luaL_checkstring(L, 1);
   const char *init = luaL_checkstring(L, 2);
@@ -781,6 +781,10 @@ extern void luai_userstatethread( lua_State *, lua_State * );
 extern void luai_userstatefree( lua_State *, lua_State * );
 #define luai_userstatethread luai_userstatethread
 #define luai_userstatefree luai_userstatefree
+extern void luai_userstategcbegin( lua_State * );
+extern void luai_userstategcend( lua_State * );
+#define luai_userstategcbegin luai_userstategcbegin
+#define luai_userstategcend luai_userstategcend
 
 
 #endif
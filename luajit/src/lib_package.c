@@ -35,6 +35,7 @@
 #if LJ_TARGET_DLOPEN
 
 #include <dlfcn.h>
+#include <unistd.h>
 
 static void ll_unloadlib(void *lib)
 {
@@ -208,6 +209,7 @@ static const char *mksymname(lua_State *L, const char *modname,
 
 extern const char *luai_moduleloadfunc;
 extern const char *luai_moduleunloadfunc;
+int luai_reloadlib(lua_State *L, const char *path, const char *sym, int nargs);
 
 static int ll_loadfunc(lua_State *L, const char *path, const char *name, int r)
 {
@@ -270,6 +272,240 @@ static int lj_cf_package_unloadlib(lua_State *L)
   return 0;
 }
 
+#if defined(__ELF__)
+#include <elf.h>
+
+#if defined(__LP64__)
+#define ELF_CLASS	ELFCLASS64
+typedef Elf64_Ehdr Elf_Ehdr;
+typedef Elf64_Phdr Elf_Phdr;
+#else
+#define ELF_CLASS	ELFCLASS32
+typedef Elf32_Ehdr Elf_Ehdr;
+typedef Elf32_Phdr Elf_Phdr;
+#endif
+
+/*
+** Checks that the segments and the section headers of the ELF library
+** in 'f' are within the file, since the dynamic loader crashes on
+** truncated libraries (like a new build still being written).
+*/
+static int ll_elfcomplete(FILE *f)
+{
+  Elf_Ehdr eh;
+  Elf_Phdr ph;
+  unsigned long end, size;
+  int i;
+  if (fseek(f, 0, SEEK_END) != 0) return 0;
+  size = (unsigned long)ftell(f);
+  rewind(f);
+  if (fread(&eh, sizeof(eh), 1, f) != 1)
+    return 0;
+  if (memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 ||
+      eh.e_ident[EI_CLASS] != ELF_CLASS) {
+    rewind(f);
+    return 1;  /* not a native ELF library; let the loader report it */
+  }
+  end = (unsigned long)eh.e_shoff + (unsigned long)eh.e_shnum * eh.e_shentsize;
+  for (i = 0; i < eh.e_phnum && end <= size; i++) {
+    unsigned long off = (unsigned long)eh.e_phoff + (unsigned long)i * eh.e_phentsize;
+    if (off > size || fseek(f, (long)off, SEEK_SET) != 0 ||
+        fread(&ph, sizeof(ph), 1, f) != 1)
+      return 0;
+    if ((unsigned long)ph.p_offset + ph.p_filesz > end)
+      end = (unsigned long)ph.p_offset + ph.p_filesz;
+  }
+  rewind(f);
+  return end <= size;
+}
+
+#else
+#define ll_elfcomplete(f)	(rewind(f), 1)
+#endif
+
+/*
+** Creates a new temporary file and pushes its name. Returns the file
+** open for writing, or NULL and an error message on the stack.
+*/
+static FILE *ll_opentmp(lua_State *L)
+{
+#if LJ_TARGET_WINDOWS
+  char dir[MAX_PATH + 1];
+  char name[MAX_PATH + 1];
+  if (GetTempPathA(sizeof(dir), dir) != 0 &&
+      GetTempFileNameA(dir, "lua", 0, name) != 0) {
+    FILE *f = fopen(name, "wb");
+    if (f) {
+      lua_pushstring(L, name);
+      return f;
+    }
+    remove(name);
+  }
+#elif LJ_TARGET_DLOPEN
+  const char *dir = getenv("TMPDIR");
+  const char *model;
+  char *name;
+  int fd;
+  if (dir == NULL || *dir == '\0') dir = "/tmp";
+  model = lua_pushfstring(L, "%s/lua_reload_XXXXXX", dir);
+  name = (char *)lua_newuserdata(L, strlen(model) + 1);
+  strcpy(name, model);
+  fd = mkstemp(name);
+  if (fd != -1) {
+    FILE *f = fdopen(fd, "wb");
+    if (f) {
+      lua_pop(L, 2);
+      lua_pushstring(L, name);
+      return f;
+    }
+    close(fd);
+    remove(name);
+  }
+  lua_pop(L, 2);
+#endif
+  lua_pushliteral(L, "cannot create a temporary file");
+  return NULL;
+}
+
+/*
+** Copies the library at 'path' to a new temporary file and pushes the
+** name of the copy, so it can be loaded while the library at 'path' is
+** still loaded (loaders return the same handle for the same file).
+** Returns the name, or NULL and an error message on the stack.
+*/
+static const char *ll_copylib(lua_State *L, const char *path)
+{
+  char buff[BUFSIZ];
+  size_t n;
+  int ok = 1;
+  const char *copy;
+  FILE *to;
+  FILE *from = fopen(path, "rb");
+  if (from == NULL) {
+    lua_pushfstring(L, "cannot open " LUA_QS, path);
+    return NULL;
+  }
+  if (!ll_elfcomplete(from)) {
+    fclose(from);
+    lua_pushfstring(L, "library " LUA_QS " is incomplete", path);
+    return NULL;
+  }
+  to = ll_opentmp(L);
+  if (to == NULL) {
+    fclose(from);
+    return NULL;
+  }
+  copy = lua_tostring(L, -1);
+  while ((n = fread(buff, 1, sizeof(buff), from)) != 0)
+    ok = ok && fwrite(buff, 1, n, to) == n;
+  ok = ok && !ferror(from);
+  fclose(from);
+  if (fclose(to) != 0 || !ok) {
+    remove(copy);
+    lua_pushfstring(L, "cannot copy " LUA_QS " to " LUA_QS, path, copy);
+    lua_remove(L, -2);
+    return NULL;
+  }
+  return copy;
+}
+
+/* __gc of reloaded libraries, whose unload function was called already */
+static int ll_gcreloaded(lua_State *L)
+{
+  void **lib = (void **)lua_touserdata(L, 1);
+  if (*lib) ll_unloadlib(*lib);
+  *lib = NULL;
+  return 0;
+}
+
+/*
+** Hot-reloads the C library loaded from 'path': loads the current file
+** at 'path' as a new library and calls its function 'sym' (or the
+** module load function) with the 'nargs' values on top of the stack.
+** Only if that succeeds, the unload function of the old library is
+** called and the new library replaces it. The old library stays loaded
+** until the state closes, since live objects might still use its code
+** (like finalizers). Returns 0 and the result of 'sym' on the stack, or
+** an error code and an error message on the stack, leaving the old
+** library untouched.
+*/
+int luai_reloadlib(lua_State *L, const char *path, const char *sym, int nargs)
+{
+  int base = lua_gettop(L) - nargs;
+  const char *copy;
+  void **reg, **tmp;
+  void *newlib;
+  lua_CFunction f;
+  lua_pushfstring(L, "LOADLIB: %s", path);
+  lua_gettable(L, LUA_REGISTRYINDEX);
+  reg = (void **)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  if (reg == NULL || *reg == NULL) {
+    lua_settop(L, base);
+    lua_pushfstring(L, "library " LUA_QS " isn't loaded", path);
+    return PACKAGE_ERR_LIB;
+  }
+  copy = ll_copylib(L, path);
+  if (copy == NULL) {
+    lua_insert(L, base + 1);  /* error message */
+    lua_settop(L, base + 1);
+    return PACKAGE_ERR_LIB;
+  }
+  newlib = ll_load(L, copy, 0);
+  remove(copy);  /* the loaded library doesn't need its file anymore */
+  if (newlib == NULL) {
+    lua_insert(L, base + 1);  /* error message */
+    lua_settop(L, base + 1);
+    return PACKAGE_ERR_LIB;
+  }
+  f = ll_sym(L, newlib, sym);
+  if (f == NULL) {
+    lua_pop(L, 1);  /* error message */
+    f = ll_sym(L, newlib, luai_moduleloadfunc);
+    if (f == NULL) {
+      ll_unloadlib(newlib);
+      lua_insert(L, base + 1);  /* error message */
+      lua_settop(L, base + 1);
+      return PACKAGE_ERR_FUNC;
+    }
+  }
+  /* keep the new library registered under the name of the copy until it
+     replaces the old one, so it's closed with the state on errors */
+  tmp = ll_register(L, copy);
+  *tmp = newlib;
+  lua_pop(L, 1);  /* pop registry entry */
+  lua_insert(L, base + 1);  /* name of the copy below the arguments */
+  lua_pushcfunction(L, f);
+  lua_insert(L, base + 2);
+  if (lua_pcall(L, nargs, 1, 0) != 0) {
+    lua_remove(L, base + 1);  /* error message on the stack */
+    return PACKAGE_ERR_FUNC;
+  }
+  f = ll_sym(L, *reg, luai_moduleunloadfunc);
+  if (f) f(L);
+  lua_settop(L, base + 2);  /* result of 'sym' (or error of 'll_sym') */
+  /* swap the handles: the entry of the copy keeps the old library, only
+     closing it when collected (the name of the copy can be reused, so
+     the entry is kept under its own address instead) */
+  *tmp = *reg;
+  *reg = newlib;
+  lua_pushfstring(L, "LOADLIB: %s", lua_tostring(L, base + 1));
+  lua_pushvalue(L, -1);
+  lua_gettable(L, LUA_REGISTRYINDEX);
+  if (luaL_newmetatable(L, "_LOADLIB_RELOADED")) {
+    lua_pushcfunction(L, ll_gcreloaded);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_setmetatable(L, -2);
+  lua_pushlightuserdata(L, tmp);
+  lua_insert(L, -2);
+  lua_settable(L, LUA_REGISTRYINDEX);
+  lua_pushnil(L);
+  lua_settable(L, LUA_REGISTRYINDEX);
+  lua_remove(L, base + 1);  /* name of the copy */
+  return 0;
+}
+
 /* ------------------------------------------------------------------------ */
 
 static int readable(const char *filename)
@@ -1,18 +1,32 @@
 #include <Lua/Interface.hpp>
+#include <Lua/Class.hpp>
 #include <stdint.h>
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
 #include <vector>
+#include <limits>
 
 #if _WIN32
 
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
 #define snprintf _snprintf
 
+#else
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #endif
 
-static const char metaname[] = "bytebuffer";
-static const char invalid_object[] = "failed to create new bytebuffer";
+static const Lua::TypeTag bytebuffer_type( "bytebuffer" );
 
 enum SeekMode
 {
@@ -21,28 +35,253 @@ enum SeekMode
 	SEEKMODE_END
 };
 
+enum MapAdvice
+{
+	MAPADVICE_NORMAL,
+	MAPADVICE_SEQUENTIAL,
+	MAPADVICE_RANDOM
+};
+
+enum ByteOrder
+{
+	BYTEORDER_LITTLE,
+	BYTEORDER_BIG,
+
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+
+	BYTEORDER_NATIVE = BYTEORDER_BIG
+
+#else
+
+	BYTEORDER_NATIVE = BYTEORDER_LITTLE
+
+#endif
+
+};
+
+// Unsigned integer with the same size as the values read and written
+template<size_t Size>
+struct SizedUnsigned;
+
+template<>
+struct SizedUnsigned<1>
+{
+	typedef uint8_t Type;
+};
+
+template<>
+struct SizedUnsigned<2>
+{
+	typedef uint16_t Type;
+};
+
+template<>
+struct SizedUnsigned<4>
+{
+	typedef uint32_t Type;
+};
+
+template<>
+struct SizedUnsigned<8>
+{
+	typedef uint64_t Type;
+};
+
+static inline uint8_t ByteSwap( uint8_t value )
+{
+	return value;
+}
+
+static inline uint16_t ByteSwap( uint16_t value )
+{
+
+#if defined _MSC_VER
+
+	return _byteswap_ushort( value );
+
+#else
+
+	return __builtin_bswap16( value );
+
+#endif
+
+}
+
+static inline uint32_t ByteSwap( uint32_t value )
+{
+
+#if defined _MSC_VER
+
+	return _byteswap_ulong( value );
+
+#else
+
+	return __builtin_bswap32( value );
+
+#endif
+
+}
+
+static inline uint64_t ByteSwap( uint64_t value )
+{
+
+#if defined _MSC_VER
+
+	return _byteswap_uint64( value );
+
+#else
+
+	return __builtin_bswap64( value );
+
+#endif
+
+}
+
 class ByteBuffer
 {
 public:
 	ByteBuffer( ) :
 		end_of_file( true ),
-		buffer_offset( 0 )
+		buffer_data( nullptr ),
+		buffer_size( 0 ),
+		buffer_offset( 0 ),
+		pins( 0 ),
+		mapped( false ),
+		writable( true )
 	{ }
 
 	ByteBuffer( size_t size ) :
 		end_of_file( true ),
-		buffer_offset( 0 )
+		buffer_data( nullptr ),
+		buffer_size( 0 ),
+		buffer_offset( 0 ),
+		pins( 0 ),
+		mapped( false ),
+		writable( true )
 	{
 		Resize( size );
 	}
 
 	ByteBuffer( const uint8_t *copy_buffer, size_t size ) :
 		end_of_file( true ),
-		buffer_offset( 0 )
+		buffer_data( nullptr ),
+		buffer_size( 0 ),
+		buffer_offset( 0 ),
+		pins( 0 ),
+		mapped( false ),
+		writable( true )
 	{
 		Assign( copy_buffer, size );
 	}
 
+	~ByteBuffer( )
+	{
+		Unmap( );
+	}
+
+	// Replaces the storage of the buffer with a memory mapping of the
+	// file at path, which can't be resized. Returns false and leaves
+	// errno set on failure.
+	bool Map( const char *path, bool map_writable, MapAdvice advice )
+	{
+		assert( path != nullptr && !mapped && pins == 0 );
+
+		size_t size = 0;
+		void *view = nullptr;
+
+#if _WIN32
+
+		DWORD flags = advice == MAPADVICE_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN :
+			advice == MAPADVICE_RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+		HANDLE file = CreateFileA( path, map_writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr );
+		if( file == INVALID_HANDLE_VALUE )
+		{
+			errno = ENOENT;
+			return false;
+		}
+
+		LARGE_INTEGER file_size;
+		if( !GetFileSizeEx( file, &file_size ) || static_cast<uint64_t>( file_size.QuadPart ) > SIZE_MAX )
+		{
+			CloseHandle( file );
+			errno = EFBIG;
+			return false;
+		}
+
+		size = static_cast<size_t>( file_size.QuadPart );
+		if( size != 0 )
+		{
+			HANDLE mapping = CreateFileMappingA( file, nullptr, map_writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr );
+			if( mapping != nullptr )
+			{
+				view = MapViewOfFile( mapping, map_writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0 );
+				CloseHandle( mapping );
+			}
+		}
+
+		CloseHandle( file );
+		if( size != 0 && view == nullptr )
+		{
+			errno = EACCES;
+			return false;
+		}
+
+#else
+
+		int file = open( path, map_writable ? O_RDWR : O_RDONLY );
+		if( file == -1 )
+			return false;
+
+		struct stat info;
+		if( fstat( file, &info ) != 0 || static_cast<uint64_t>( info.st_size ) > SIZE_MAX )
+		{
+			int error = errno != 0 ? errno : EFBIG;
+			close( file );
+			errno = error;
+			return false;
+		}
+
+		size = static_cast<size_t>( info.st_size );
+		if( size != 0 )
+		{
+			view = mmap( nullptr, size, map_writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0 );
+			if( view == MAP_FAILED )
+			{
+				int error = errno;
+				close( file );
+				errno = error;
+				return false;
+			}
+
+			int flags = advice == MAPADVICE_SEQUENTIAL ? MADV_SEQUENTIAL :
+				advice == MAPADVICE_RANDOM ? MADV_RANDOM : MADV_NORMAL;
+			madvise( view, size, flags );
+		}
+
+		close( file );
+
+#endif
+
+		std::vector<uint8_t>( ).swap( buffer_internal );
+		buffer_data = static_cast<uint8_t *>( view );
+		buffer_size = size;
+		buffer_offset = 0;
+		end_of_file = false;
+		mapped = true;
+		writable = map_writable;
+		return true;
+	}
+
+	bool IsMapped( ) const
+	{
+		return mapped;
+	}
+
+	bool IsWritable( ) const
+	{
+		return writable;
+	}
+
 	typedef void ( *unspecified_bool_type ) ( );
 	static void unspecified_bool_true( ) { }
 
@@ -68,21 +307,21 @@ public:
 
 	size_t Size( ) const
 	{
-		return buffer_internal.size( );
+		return buffer_size;
 	}
 
 	size_t Capacity( ) const
 	{
-		return buffer_internal.capacity( );
+		return mapped ? buffer_size : buffer_internal.capacity( );
 	}
 
-	bool Seek( int32_t position, SeekMode mode = SEEKMODE_SET )
+	bool Seek( int64_t position, SeekMode mode = SEEKMODE_SET )
 	{
 		assert( mode != SEEKMODE_SET || ( mode == SEEKMODE_SET && position >= 0 ) );
-		assert( mode != SEEKMODE_CUR || ( mode == SEEKMODE_CUR && Tell( ) + position >= 0 ) );
-		assert( mode != SEEKMODE_END || ( mode == SEEKMODE_END && Size( ) + position >= 0 ) );
+		assert( mode != SEEKMODE_CUR || ( mode == SEEKMODE_CUR && static_cast<int64_t>( Tell( ) ) + position >= 0 ) );
+		assert( mode != SEEKMODE_END || ( mode == SEEKMODE_END && static_cast<int64_t>( Size( ) ) + position >= 0 ) );
 
-		int32_t temp;
+		int64_t temp;
 		switch( mode )
 		{
 		case SEEKMODE_SET:
@@ -90,12 +329,12 @@ public:
 			break;
 
 		case SEEKMODE_CUR:
-			temp = Tell( ) + position;
+			temp = static_cast<int64_t>( Tell( ) ) + position;
 			buffer_offset = static_cast<size_t>( temp > 0 ? temp : 0 );
 			break;
 
 		case SEEKMODE_END:
-			temp = Size( ) + position;
+			temp = static_cast<int64_t>( Size( ) ) + position;
 			buffer_offset = static_cast<size_t>( temp > 0 ? temp : 0 );
 			break;
 
@@ -114,59 +353,86 @@ public:
 
 	uint8_t *GetBuffer( )
 	{
-		return &buffer_internal[0];
+		return buffer_data;
 	}
 
 	const uint8_t *GetBuffer( ) const
 	{
-		return &buffer_internal[0];
+		return buffer_data;
 	}
 
+	// Changing the size of mapped buffers isn't supported
 	void Clear( )
 	{
+		assert( !mapped );
+
 		buffer_internal.clear( );
 		buffer_offset = 0;
 		end_of_file = false;
+		Sync( );
 	}
 
 	void Reserve( size_t capacity )
 	{
+		assert( !mapped );
+
+		if( pins != 0 && capacity > Capacity( ) )
+			Reallocate( capacity );
+
 		buffer_internal.reserve( capacity );
+		Sync( );
 	}
 
 	void Resize( size_t size )
 	{
+		assert( !mapped );
+
+		if( pins != 0 && size > Capacity( ) )
+			Reallocate( size > Capacity( ) * 2 ? size : Capacity( ) * 2 );
+
 		buffer_internal.resize( size );
+		Sync( );
 	}
 
 	void ShrinkToFit( )
 	{
-		std::vector<uint8_t>( buffer_internal ).swap( buffer_internal );
+		assert( !mapped );
+
+		std::vector<uint8_t> fitted( buffer_internal );
+		fitted.swap( buffer_internal );
+		if( pins != 0 )
+			retired.push_back( std::move( fitted ) );
+
+		Sync( );
 	}
 
 	void Assign( const uint8_t *copy_buffer, size_t size )
 	{
-		assert( copy_buffer != nullptr && size != 0 );
+		assert( copy_buffer != nullptr && size != 0 && !mapped );
+
+		if( pins != 0 && size > Capacity( ) )
+			Reallocate( size );
 
 		buffer_internal.assign( copy_buffer, copy_buffer + size );
 		buffer_offset = 0;
 		end_of_file = false;
+		Sync( );
 	}
 
 	size_t Read( void *value, size_t size )
 	{
 		assert( value != nullptr && size != 0 );
 
-		if( buffer_offset >= buffer_internal.size( ) )
+		if( buffer_offset >= buffer_size )
 		{
 			end_of_file = true;
 			return 0;
 		}
 
-		size_t clamped = buffer_internal.size( ) - buffer_offset;
+		size_t clamped = buffer_size - buffer_offset;
 		if( clamped > size )
 			clamped = size;
-		memcpy( value, &buffer_internal[buffer_offset], clamped );
+		memcpy( value, buffer_data + buffer_offset, clamped );
 		buffer_offset += clamped;
 		if( clamped < size )
 			end_of_file = true;
@@ -174,18 +440,121 @@ public:
 		return clamped;
 	}
 
+	// Mapped buffers are only written in place, when they're writable
 	size_t Write( const void *value, size_t size )
 	{
 		assert( value != nullptr && size != 0 );
 
-		if( buffer_internal.size( ) < buffer_offset + size )
+		if( buffer_size < buffer_offset + size )
+		{
+			if( mapped )
+				return 0;
+
 			Resize( buffer_offset + size );
+		}
+		else if( !writable )
+			return 0;
 
-		memcpy( &buffer_internal[buffer_offset], value, size );
+		memcpy( buffer_data + buffer_offset, value, size );
 		buffer_offset += size;
 		return size;
 	}
 
+	// Reads a value of fixed size stored with the given byte order
+	template<typename T, ByteOrder order>
+	bool ReadValue( T &data )
+	{
+		typedef typename SizedUnsigned<sizeof( T )>::Type Bits;
+
+		Bits bits;
+		if( buffer_size < buffer_offset + sizeof( T ) )
+		{
+			// Consumes what's left and sets the end of file
+			Read( &bits, sizeof( T ) );
+			return false;
+		}
+
+		memcpy( &bits, buffer_data + buffer_offset, sizeof( T ) );
+		buffer_offset += sizeof( T );
+
+		if( order != BYTEORDER_NATIVE )
+			bits = ByteSwap( bits );
+
+		memcpy( &data, &bits, sizeof( T ) );
+		return true;
+	}
+
+	template<typename T, ByteOrder order>
+	void WriteValue( T data )
+	{
+		typedef typename SizedUnsigned<sizeof( T )>::Type Bits;
+
+		Bits bits;
+		memcpy( &bits, &data, sizeof( T ) );
+
+		if( order != BYTEORDER_NATIVE )
+			bits = ByteSwap( bits );
+
+		Write( &bits, sizeof( T ) );
+	}
+
+	// Slices point into the storage of the buffer, so while there are
+	// slices the storage is only retired when it has to move, instead
+	// of being freed (slices see writes made in place, though)
+	void Pin( )
+	{
+		++pins;
+	}
+
+	void Unpin( )
+	{
+		assert( pins != 0 );
+
+		if( pins != 0 && --pins == 0 )
+			retired.clear( );
+	}
+
+	// Returns the next size bytes of the buffer and skips them, or
+	// nullptr (skipping what's left) if there aren't enough bytes
+	const uint8_t *Consume( size_t size )
+	{
+		if( buffer_size < buffer_offset + size )
+		{
+			buffer_offset = buffer_size;
+			end_of_file = true;
+			return nullptr;
+		}
+
+		const uint8_t *data = buffer_data + buffer_offset;
+		buffer_offset += size;
+		return data;
+	}
+
+	// Returns the zero terminated string at the current position and
+	// skips it, like operator>>( std::string & ) but without copies
+	const char *ReadString( size_t &len )
+	{
+		if( buffer_offset >= buffer_size )
+		{
+			end_of_file = true;
+			return nullptr;
+		}
+
+		const char *data = reinterpret_cast<const char *>( buffer_data + buffer_offset );
+		size_t left = buffer_size - buffer_offset;
+		const void *zero = memchr( data, 0, left );
+		if( zero == nullptr )
+		{
+			buffer_offset = buffer_size;
+			end_of_file = true;
+			return nullptr;
+		}
+
+		len = static_cast<size_t>( static_cast<const char *>( zero ) - data );
+		buffer_offset += len + 1;
+		return data;
+	}
+
 	ByteBuffer &operator>>( bool &data )
 	{
 		bool value;
@@ -466,61 +835,218 @@ public:
 	}
 
 private:
+	ByteBuffer( const ByteBuffer & );
+	ByteBuffer &operator=( const ByteBuffer & );
+
+	// Moves the contents to new storage, keeping the old one for slices
+	void Reallocate( size_t capacity )
+	{
+		std::vector<uint8_t> storage;
+		storage.reserve( capacity );
+		storage.assign( buffer_internal.begin( ), buffer_internal.end( ) );
+		storage.swap( buffer_internal );
+		retired.push_back( std::move( storage ) );
+	}
+
+	// Reads and writes go through buffer_data and buffer_size, which
+	// point to the vector or to the mapped file
+	void Sync( )
+	{
+		buffer_data = buffer_internal.data( );
+		buffer_size = buffer_internal.size( );
+	}
+
+	void Unmap( )
+	{
+		if( !mapped || buffer_data == nullptr )
+			return;
+
+#if _WIN32
+
+		UnmapViewOfFile( buffer_data );
+
+#else
+
+		munmap( buffer_data, buffer_size );
+
+#endif
+
+	}
+
 	bool end_of_file;
 	std::vector<uint8_t> buffer_internal;
+	uint8_t *buffer_data;
+	size_t buffer_size;
 	size_t buffer_offset;
+	size_t pins;
+	std::vector<std::vector<uint8_t>> retired;
+	bool mapped;
+	bool writable;
 };
 
+enum FormatCode
+{
+	FORMAT_I8,
+	FORMAT_U8,
+	FORMAT_I16,
+	FORMAT_U16,
+	FORMAT_I32,
+	FORMAT_U32,
+	FORMAT_I64,
+	FORMAT_U64,
+	FORMAT_F32,
+	FORMAT_F64,
+	FORMAT_STRING,
+	FORMAT_FIXEDSTRING,
+	FORMAT_PADDING
+};
+
+struct FormatOp
+{
+	uint8_t code;
+	uint8_t order;
+	uint32_t count;
+};
+
+// Compiled format string, kept in a full userdata
+struct Format
+{
+	size_t num_ops;
+	size_t num_values;
+	size_t min_size;
+	FormatOp ops[1];
+};
+
+// Key of the table with the compiled formats, in the metatable
+static const char format_cache_key = 0;
+
 namespace bytebuffer
 {
 	static int create( lua_State *state )
 	{
 		Lua::Interface &lua = GetLuaInterface( state );
-		ByteBuffer *buffer = reinterpret_cast<ByteBuffer *>( lua.NewUserdata( sizeof( ByteBuffer ) ) );
-		if( buffer == nullptr )
-			lua.ThrowError( invalid_object );
+		ByteBuffer &buffer = Lua::Class<ByteBuffer>::New( lua );
+
+		lua.CreateTable( );
+		lua.SetUserValue( -2 );
+
+		size_t size = 0;
+		const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.ToStringView( 1, &size ) );
+		if( data != nullptr && size != 0 )
+			buffer.Assign( data, size );
+
+		return 1;
+	}
+
+	// Creates a buffer from the file at argument 1, mapped in memory with
+	// the mode at argument 2 ("r" for read-only or "r+" for read-write,
+	// where writes go to the file) and the access pattern of argument 3
+	// ("sequential", "random" or "normal") as a hint for the system
+	static int map( lua_State *state )
+	{
+		static const char *modes[] = { "r", "r+", nullptr };
+		static const char *advices[] = { "normal", "sequential", "random", nullptr };
+
+		Lua::Interface &lua = GetLuaInterface( state );
+		const char *path = lua.CheckString( 1 );
+		const char *mode = lua.OptionalString( 2, "r" );
+		const char *advice = lua.OptionalString( 3, "sequential" );
+
+		int mode_index = 0;
+		while( modes[mode_index] != nullptr && strcmp( modes[mode_index], mode ) != 0 )
+			++mode_index;
+
+		if( modes[mode_index] == nullptr )
+			return lua.ArgError( 2, "invalid mode (use \"r\" or \"r+\")" );
 
-		new( buffer ) ByteBuffer( );
+		int advice_index = 0;
+		while( advices[advice_index] != nullptr && strcmp( advices[advice_index], advice ) != 0 )
+			++advice_index;
 
-		lua.NewMetatable( metaname );
-		lua.SetMetaTable( -2 );
+		if( advices[advice_index] == nullptr )
+			return lua.ArgError( 3, "invalid access pattern (use \"normal\", \"sequential\" or \"random\")" );
+
+		ByteBuffer &buffer = Lua::Class<ByteBuffer>::New( lua );
 
 		lua.CreateTable( );
 		lua.SetUserValue( -2 );
 
-		if( lua.GetType( 1 ) == Lua::Type::String )
+		if( !buffer.Map( path, mode_index == 1, static_cast<MapAdvice>( advice_index ) ) )
 		{
-			size_t size = 0;
-			const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.ToString( 1, &size ) );
-			buffer->Assign( data, size );
+			lua.PushNil( );
+			lua.PushFormattedString( "%s: %s", path, strerror( errno ) );
+			return 2;
 		}
 
 		return 1;
 	}
 
-	static int destroy( lua_State *state )
+	// Makes bytebuffer( ... ) work like bytebuffer.new( ... )
+	static int call( lua_State *state )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.ToUserdata<ByteBuffer>( 1 )->~ByteBuffer( );
+		GetLuaInterface( state ).Remove( 1 );
+		return create( state );
+	}
+
+	// Mapped buffers have a fixed size and might be read-only
+	static void CheckWrite( Lua::Interface &lua, ByteBuffer &buffer, size_t size )
+	{
+		if( !buffer.IsMapped( ) )
+			return;
+
+		if( !buffer.IsWritable( ) )
+			lua.ThrowError( "bytebuffer is mapped read-only" );
+
+		if( buffer.Tell( ) > buffer.Size( ) || buffer.Size( ) - buffer.Tell( ) < size )
+			lua.ThrowError( "write past the end of a mapped bytebuffer" );
+	}
+
+	static void CheckResize( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		if( buffer.IsMapped( ) )
+			lua.ThrowError( "mapped bytebuffers can't be resized" );
+	}
+
+	static int reserve( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		long long capacity = lua.CheckInteger( 2 );
+		CheckResize( lua, buffer );
+		buffer.Reserve( static_cast<size_t>( capacity ) );
 		return 0;
 	}
 
-	static int tostring( lua_State *state )
+	static int resize( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		long long size = lua.CheckInteger( 2 );
+		CheckResize( lua, buffer );
+		buffer.Resize( static_cast<size_t>( size ) );
+		return 0;
+	}
+
+	static int clear( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		CheckResize( lua, buffer );
+		buffer.Clear( );
+		return 0;
+	}
+
+	static int shrinktofit( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		CheckResize( lua, buffer );
+		buffer.ShrinkToFit( );
+		return 0;
+	}
+
+	static int tostring( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		char msg[30];
-		snprintf( msg, sizeof( msg ), "%s: 0x%p", metaname, lua.ToUserdata<ByteBuffer>( 1 ) );
+		snprintf( msg, sizeof( msg ), "%s: 0x%p", bytebuffer_type.GetName( ), &buffer );
 		lua.PushString( msg );
 		return 1;
 	}
 
-	static int index( lua_State *state )
+	static int index( Lua::Interface &lua, ByteBuffer & )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-
 		lua.GetUserValue( 1 );
 		lua.PushValue( 2 );
 		lua.RawGet( -2 );
@@ -530,17 +1056,13 @@ namespace bytebuffer
 
 		lua.Pop( 2 );
 
-		lua.GetMetaTable( 1 );
 		lua.PushValue( 2 );
-		lua.RawGet( -2 );
-
+		lua.RawGet( Lua::Interface::UpvalueIndex( 2 ) );
 		return 1;
 	}
 
-	static int newindex( lua_State *state )
+	static int newindex( Lua::Interface &lua, ByteBuffer & )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		lua.GetUserValue( 1 );
 		lua.PushValue( 2 );
 		lua.PushValue( 3 );
@@ -548,55 +1070,103 @@ namespace bytebuffer
 		return 0;
 	}
 
-	static int readinteger( lua_State *state )
+	// Integers are pushed as integers, so 64 bits values are kept on
+	// Lua 5.3 (unsigned ones above the signed range wrap around)
+	template<typename T>
+	static void PushValue( Lua::Interface &lua, T value )
+	{
+		lua.PushInteger( static_cast<long long>( value ) );
+	}
+
+	static void PushValue( Lua::Interface &lua, float value )
+	{
+		lua.PushNumber( value );
+	}
+
+	static void PushValue( Lua::Interface &lua, double value )
+	{
+		lua.PushNumber( value );
+	}
+
+	// Integers are taken as they are (64 bits types take their bits, so
+	// wrapped values pushed by reads are written back), other numbers
+	// are truncated, and values out of the range of T raise an error
+	template<typename T>
+	static T ToValue( Lua::Interface &lua, int stackpos )
+	{
+		typedef std::numeric_limits<T> limits;
+		if( lua.IsInteger( stackpos ) )
+		{
+			long long integer = lua.ToInteger( stackpos );
+			if( sizeof( T ) < sizeof( long long ) &&
+				( integer < static_cast<long long>( limits::min( ) ) || integer > static_cast<long long>( limits::max( ) ) ) )
+				lua.ArgError( stackpos, "value out of range" );
+
+			return static_cast<T>( integer );
+		}
+
+		// The bounds are powers of 2, exact as doubles (and NaN fails)
+		double number = trunc( lua.ToNumber( stackpos ) );
+		double lower = limits::is_signed ? -ldexp( 1.0, limits::digits ) : 0.0;
+		if( !( number >= lower && number < ldexp( 1.0, limits::digits ) ) )
+			lua.ArgError( stackpos, "value out of range" );
+
+		if( number >= 9223372036854775808.0 )
+			return static_cast<T>( static_cast<unsigned long long>( number ) );
+
+		return static_cast<T>( static_cast<long long>( number ) );
+	}
+
+	template<>
+	float ToValue<float>( Lua::Interface &lua, int stackpos )
+	{
+		return static_cast<float>( lua.ToNumber( stackpos ) );
+	}
+
+	template<>
+	double ToValue<double>( Lua::Interface &lua, int stackpos )
+	{
+		return lua.ToNumber( stackpos );
+	}
+
+	template<typename T, ByteOrder order>
+	static int read( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		T value;
+		if( !buffer.ReadValue<T, order>( value ) )
+			return 0;
+
+		PushValue( lua, value );
+		return 1;
+	}
+
+	template<typename T, ByteOrder order>
+	static int write( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		lua.CheckType( 2, Lua::Type::Number );
+		CheckWrite( lua, buffer, sizeof( T ) );
+		buffer.WriteValue<T, order>( ToValue<T>( lua, 2 ) );
+		return 0;
+	}
+
+	static int readinteger( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		lua.CheckType( 2, Lua::Type::Number );
 
-		ByteBuffer &buffer = *lua.ToUserdata<ByteBuffer>( 1 );
 		if( lua.IsType( 3, Lua::Type::Boolean ) && lua.ToBoolean( 3 ) )
 			switch( static_cast<int32_t>( lua.ToNumber( 2 ) ) )
 			{
 			case 1:
-			{
-				uint8_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( number );
-				break;
-			}
+				return read<uint8_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 2:
-			{
-				uint16_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( number );
-				break;
-			}
+				return read<uint16_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 4:
-			{
-				uint32_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( number );
-				break;
-			}
+				return read<uint32_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 8:
-			{
-				uint64_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( static_cast<double>( number ) );
-				break;
-			}
+				return read<uint64_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			default:
 				return lua.ArgError( 2, "requested number of bytes to read not implemented (only 1, 2, 4 and 8 can be used)" );
@@ -605,130 +1175,82 @@ namespace bytebuffer
 			switch( static_cast<int32_t>( lua.ToNumber( 2 ) ) )
 			{
 			case 1:
-			{
-				int8_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( number );
-				break;
-			}
+				return read<int8_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 2:
-			{
-				int16_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( number );
-				break;
-			}
+				return read<int16_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 4:
-			{
-				int32_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( number );
-				break;
-			}
+				return read<int32_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 8:
-			{
-				int64_t number;
-				if( !( buffer >> number ) )
-					return 0;
-
-				lua.PushNumber( static_cast<double>( number ) );
-				break;
-			}
+				return read<int64_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			default:
 				return lua.ArgError( 2, "requested number of bytes to read not implemented (only 1, 2, 4 and 8 can be used)" );
 			}
-
-		return 1;
 	}
 
-	static int readfloat( lua_State *state )
+	static int readfloat( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-
 		float number;
-		if( !( *lua.ToUserdata<ByteBuffer>( 1 ) >> number ) )
+		if( !( buffer >> number ) )
 			return 0;
 
 		lua.PushNumber( number );
 		return 1;
 	}
 
-	static int readdouble( lua_State *state )
+	static int readdouble( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-
 		double number;
-		if( !( *lua.ToUserdata<ByteBuffer>( 1 ) >> number ) )
+		if( !( buffer >> number ) )
 			return 0;
 
 		lua.PushNumber( number );
 		return 1;
 	}
 
-	static int readbool( lua_State *state )
+	static int readbool( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-
 		bool number;
-		if( !( *lua.ToUserdata<ByteBuffer>( 1 ) >> number ) )
+		if( !( buffer >> number ) )
 			return 0;
 
 		lua.PushNumber( number );
 		return 1;
 	}
 
-	static int readstring( lua_State *state )
+	static int readstring( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-
-		std::string str;
-		if( !( *lua.ToUserdata<ByteBuffer>( 1 ) >> str ) )
+		size_t len = 0;
+		const char *data = buffer.ReadString( len );
+		if( data == nullptr )
 			return 0;
 
-		lua.PushString( str.c_str( ), str.size( ) );
+		lua.PushString( data, len );
 		return 1;
 	}
 
-	static int writeinteger( lua_State *state )
+	static int writeinteger( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		lua.CheckType( 2, Lua::Type::Number );
 		lua.CheckType( 3, Lua::Type::Number );
 
-		ByteBuffer &buffer = *lua.ToUserdata<ByteBuffer>( 1 );
 		if( lua.IsType( 4, Lua::Type::Boolean ) && lua.ToBoolean( 4 ) )
 			switch( static_cast<int32_t>( lua.ToNumber( 3 ) ) )
 			{
 			case 1:
-				buffer << static_cast<const uint8_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<uint8_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 2:
-				buffer << static_cast<const uint16_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<uint16_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 4:
-				buffer << static_cast<const uint32_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<uint32_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 8:
-				buffer << static_cast<const uint64_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<uint64_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			default:
 				return lua.ArgError( 3, "requested number of bytes to read not implemented (only 1, 2, 4 and 8 can be used)" );
@@ -737,259 +1259,590 @@ namespace bytebuffer
 			switch( static_cast<int32_t>( lua.ToNumber( 3 ) ) )
 			{
 			case 1:
-				buffer << static_cast<const int8_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<int8_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 2:
-				buffer << static_cast<const int16_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<int16_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 4:
-				buffer << static_cast<const int32_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<int32_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			case 8:
-				buffer << static_cast<const int64_t>( lua.ToNumber( 2 ) );
-				break;
+				return write<int64_t, BYTEORDER_NATIVE>( lua, buffer );
 
 			default:
 				return lua.ArgError( 3, "requested number of bytes to read not implemented (only 1, 2, 4 and 8 can be used)" );
 			}
-
-		return 0;
 	}
 
-	static int writefloat( lua_State *state )
+	static int writefloat( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		lua.CheckType( 2, Lua::Type::Number );
-		*lua.ToUserdata<ByteBuffer>( 1 ) << static_cast<float>( lua.ToNumber( 2 ) );
+		CheckWrite( lua, buffer, sizeof( float ) );
+		buffer << static_cast<float>( lua.ToNumber( 2 ) );
 		return 0;
 	}
 
-	static int writedouble( lua_State *state )
+	static int writedouble( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		lua.CheckType( 2, Lua::Type::Number );
-		*lua.ToUserdata<ByteBuffer>( 1 ) << lua.ToNumber( 2 );
+		CheckWrite( lua, buffer, sizeof( double ) );
+		buffer << lua.ToNumber( 2 );
 		return 0;
 	}
 
-	static int writebool( lua_State *state )
+	static int writebool( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
 		lua.CheckType( 2, Lua::Type::Boolean );
-		*lua.ToUserdata<ByteBuffer>( 1 ) << ( lua.ToBoolean( 2 ) == 1 );
+		CheckWrite( lua, buffer, sizeof( bool ) );
+		buffer << lua.ToBoolean( 2 );
 		return 0;
 	}
 
-	static int writestring( lua_State *state )
+	static int writestring( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::String );
-		*lua.ToUserdata<ByteBuffer>( 1 ) << lua.ToString( 2 );
-		return 0;
-	}
-
-	static int assign( lua_State *state )
-	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::String );
 		size_t len = 0;
-		const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.ToString( 2, &len ) );
-		lua.ToUserdata<ByteBuffer>( 1 )->Assign( data, len );
-		return 0;
-	}
+		const char *data = lua.CheckStringView( 2, &len );
 
-	static int reserve( lua_State *state )
-	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::Number );
-		lua.ToUserdata<ByteBuffer>( 1 )->Reserve( static_cast<size_t>( lua.ToNumber( 2 ) ) );
-		return 0;
-	}
+		// Written up to the first zero, like C strings
+		const void *zero = memchr( data, 0, len );
+		if( zero != nullptr )
+			len = static_cast<size_t>( static_cast<const char *>( zero ) - data );
 
-	static int resize( lua_State *state )
-	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::String );
-		lua.ToUserdata<ByteBuffer>( 1 )->Resize( static_cast<size_t>( lua.ToNumber( 2 ) ) );
-		return 0;
-	}
+		CheckWrite( lua, buffer, len + 1 );
+		if( len != 0 )
+			buffer.Write( data, len );
 
-	static int clear( lua_State *state )
-	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.ToUserdata<ByteBuffer>( 1 )->Clear( );
+		buffer << '\0';
 		return 0;
 	}
 
-	static int tell( lua_State *state )
-	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.PushNumber( lua.ToUserdata<ByteBuffer>( 1 )->Tell( ) );
-		return 1;
+	// Parses a format: < > and = select little, big and native byte
+	// order for the options that follow, b B h H i I l L are 8, 16, 32
+	// and 64 bits integers (signed and unsigned), f and d are floats and
+	// doubles, z is a zero terminated string, A is a string of fixed size
+	// and x is a padding byte. A count can follow each option, to repeat
+	// it (or as the size of A strings).
+	// Integer letters are the ones of string.pack in Lua 5.3, with fixed
+	// sizes (i I are 32 bits and l L 64 bits everywhere), while counts and
+	// A come from lpack. So unlike modules/pack/lpack.c, b is a signed byte
+	// (lpack's b is unsigned and c signed), l L don't follow the size of
+	// long, and there's no n nor strings prefixed by their size (p P a).
+	// Returns the number of ops, which are stored if ops isn't nullptr.
+	static size_t ParseFormat( Lua::Interface &lua, const char *fmt, size_t len, FormatOp *ops, size_t &num_values )
+	{
+		size_t num_ops = 0;
+		num_values = 0;
+		ByteOrder order = BYTEORDER_NATIVE;
+		for( size_t k = 0; k < len; )
+		{
+			char option = fmt[k++];
+			FormatOp op = { 0, static_cast<uint8_t>( order ), 1 };
+			switch( option )
+			{
+			case ' ':
+				continue;
+
+			case '<':
+				order = BYTEORDER_LITTLE;
+				continue;
+
+			case '>':
+				order = BYTEORDER_BIG;
+				continue;
+
+			case '=':
+				order = BYTEORDER_NATIVE;
+				continue;
+
+			case 'b': op.code = FORMAT_I8; break;
+			case 'B': op.code = FORMAT_U8; break;
+			case 'h': op.code = FORMAT_I16; break;
+			case 'H': op.code = FORMAT_U16; break;
+			case 'i': op.code = FORMAT_I32; break;
+			case 'I': op.code = FORMAT_U32; break;
+			case 'l': op.code = FORMAT_I64; break;
+			case 'L': op.code = FORMAT_U64; break;
+			case 'f': op.code = FORMAT_F32; break;
+			case 'd': op.code = FORMAT_F64; break;
+			case 'z': op.code = FORMAT_STRING; break;
+			case 'A': op.code = FORMAT_FIXEDSTRING; break;
+			case 'x': op.code = FORMAT_PADDING; break;
+
+			default:
+				lua.ThrowError( "invalid format option '%c'", option );
+			}
+
+			if( k < len && fmt[k] >= '0' && fmt[k] <= '9' )
+			{
+				uint32_t count = 0;
+				for( ; k < len && fmt[k] >= '0' && fmt[k] <= '9'; ++k )
+				{
+					if( count > ( INT32_MAX - 9 ) / 10 )
+						lua.ThrowError( "format count overflow" );
+
+					count = count * 10 + static_cast<uint32_t>( fmt[k] - '0' );
+				}
+
+				op.count = count;
+			}
+
+			if( op.code == FORMAT_FIXEDSTRING )
+				++num_values;
+			else if( op.code != FORMAT_PADDING )
+				num_values += op.count;
+
+			if( num_values > INT32_MAX )
+				lua.ThrowError( "format has too many values" );
+
+			if( ops != nullptr )
+				ops[num_ops] = op;
+
+			++num_ops;
+		}
+
+		return num_ops;
 	}
 
-	static int size( lua_State *state )
+	// Pushes the compiled format of a format string
+	static const Format &CompileFormat( Lua::Interface &lua, const char *fmt, size_t len )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.PushNumber( lua.ToUserdata<ByteBuffer>( 1 )->Size( ) );
-		return 1;
+		size_t num_values = 0;
+		size_t num_ops = ParseFormat( lua, fmt, len, nullptr, num_values );
+		Format &format = *static_cast<Format *>( lua.NewUserdata( sizeof( Format ) + ( num_ops != 0 ? num_ops - 1 : 0 ) * sizeof( FormatOp ) ) );
+		format.num_ops = ParseFormat( lua, fmt, len, format.ops, format.num_values );
+
+		// Smallest number of bytes a record takes (z strings take at least
+		// their terminator)
+		static const size_t op_sizes[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8, 1, 1, 1 };
+		format.min_size = 0;
+		for( size_t k = 0; k < format.num_ops; ++k )
+			format.min_size += op_sizes[format.ops[k].code] * format.ops[k].count;
+
+		return format;
 	}
 
-	static int capacity( lua_State *state )
+	// Returns the compiled format of argument stackpos, compiling it
+	// only the first time it's used in the state
+	static const Format &CheckFormat( Lua::Interface &lua, int stackpos )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.PushNumber( lua.ToUserdata<ByteBuffer>( 1 )->Capacity( ) );
-		return 1;
+		size_t len = 0;
+		const char *fmt = lua.CheckStringView( stackpos, &len );
+
+		lua.PushLightUserdata( const_cast<char *>( &format_cache_key ) );
+		lua.RawGet( Lua::Interface::UpvalueIndex( 1 ) );
+		if( !lua.IsType( -1, Lua::Type::Table ) )
+		{
+			// Compiled formats are dropped on collections, so formats
+			// built on the fly don't pile up
+			lua.Pop( 1 );
+			lua.CreateTable( );
+			lua.CreateTable( 0, 1 );
+			lua.PushString( "v" );
+			lua.SetField( -2, "__mode" );
+			lua.SetMetaTable( -2 );
+			lua.PushLightUserdata( const_cast<char *>( &format_cache_key ) );
+			lua.PushValue( -2 );
+			lua.RawSet( Lua::Interface::UpvalueIndex( 1 ) );
+		}
+
+		lua.PushString( fmt, len );
+		lua.RawGet( -2 );
+		const Format *format = static_cast<const Format *>( lua.ToUserdata( -1 ) );
+		if( format == nullptr )
+		{
+			lua.Pop( 1 );
+			format = &CompileFormat( lua, fmt, len );
+			lua.PushString( fmt, len );
+			lua.PushValue( -2 );
+			lua.RawSet( -4 );
+		}
+
+		// The compiled format is kept alive by the stack
+		lua.Remove( -2 );
+		return *format;
 	}
 
-	static int shrinktofit( lua_State *state )
+	template<typename T>
+	static bool ReadFormatValues( Lua::Interface &lua, ByteBuffer &buffer, const FormatOp &op )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.ToUserdata<ByteBuffer>( 1 )->ShrinkToFit( );
-		return 0;
+		T value;
+		for( uint32_t k = 0; k < op.count; ++k )
+		{
+			bool read = op.order == BYTEORDER_NATIVE ?
+				buffer.ReadValue<T, BYTEORDER_NATIVE>( value ) :
+				op.order == BYTEORDER_LITTLE ?
+					buffer.ReadValue<T, BYTEORDER_LITTLE>( value ) :
+					buffer.ReadValue<T, BYTEORDER_BIG>( value );
+			if( !read )
+				return false;
+
+			PushValue( lua, value );
+		}
+
+		return true;
 	}
 
-	static int seek( lua_State *state )
+	// Pushes the values of a record, returning false (with some values
+	// pushed) if the buffer ends before the record
+	static bool ReadFormat( Lua::Interface &lua, ByteBuffer &buffer, const Format &format )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::Number );
-		lua.PushNumber( lua.ToUserdata<ByteBuffer>( 1 )->Seek( static_cast<int32_t>( lua.ToNumber( 2 ) ) ) );
-		return 1;
+		for( size_t n = 0; n < format.num_ops; ++n )
+		{
+			const FormatOp &op = format.ops[n];
+			bool read = true;
+			switch( op.code )
+			{
+			case FORMAT_I8: read = ReadFormatValues<int8_t>( lua, buffer, op ); break;
+			case FORMAT_U8: read = ReadFormatValues<uint8_t>( lua, buffer, op ); break;
+			case FORMAT_I16: read = ReadFormatValues<int16_t>( lua, buffer, op ); break;
+			case FORMAT_U16: read = ReadFormatValues<uint16_t>( lua, buffer, op ); break;
+			case FORMAT_I32: read = ReadFormatValues<int32_t>( lua, buffer, op ); break;
+			case FORMAT_U32: read = ReadFormatValues<uint32_t>( lua, buffer, op ); break;
+			case FORMAT_I64: read = ReadFormatValues<int64_t>( lua, buffer, op ); break;
+			case FORMAT_U64: read = ReadFormatValues<uint64_t>( lua, buffer, op ); break;
+			case FORMAT_F32: read = ReadFormatValues<float>( lua, buffer, op ); break;
+			case FORMAT_F64: read = ReadFormatValues<double>( lua, buffer, op ); break;
+
+			case FORMAT_STRING:
+				for( uint32_t k = 0; k < op.count && read; ++k )
+				{
+					size_t len = 0;
+					const char *data = buffer.ReadString( len );
+					read = data != nullptr;
+					if( read )
+						lua.PushString( data, len );
+				}
+
+				break;
+
+			case FORMAT_FIXEDSTRING:
+			{
+				const uint8_t *data = buffer.Consume( op.count );
+				read = data != nullptr;
+				if( read )
+					lua.PushString( reinterpret_cast<const char *>( data ), op.count );
+
+				break;
+			}
+
+			case FORMAT_PADDING:
+				read = buffer.Consume( op.count ) != nullptr;
+				break;
+			}
+
+			if( !read )
+				return false;
+		}
+
+		return true;
 	}
 
-	static int isvalid( lua_State *state )
+	template<typename T>
+	static int WriteFormatValues( Lua::Interface &lua, ByteBuffer &buffer, const FormatOp &op, int arg )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::Number );
-		lua.PushBoolean( lua.ToUserdata<ByteBuffer>( 1 )->IsValid( ) );
-		return 1;
+		for( uint32_t k = 0; k < op.count; ++k, ++arg )
+		{
+			lua.CheckType( arg, Lua::Type::Number );
+			CheckWrite( lua, buffer, sizeof( T ) );
+			T value = ToValue<T>( lua, arg );
+			if( op.order == BYTEORDER_NATIVE )
+				buffer.WriteValue<T, BYTEORDER_NATIVE>( value );
+			else if( op.order == BYTEORDER_LITTLE )
+				buffer.WriteValue<T, BYTEORDER_LITTLE>( value );
+			else
+				buffer.WriteValue<T, BYTEORDER_BIG>( value );
+		}
+
+		return arg;
 	}
 
-	static int eof( lua_State *state )
+	// Reads a record with the format of argument 2 and returns its
+	// values, or nothing if the buffer ends before the record
+	static int readformat( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		lua.CheckType( 2, Lua::Type::Number );
-		lua.PushBoolean( lua.ToUserdata<ByteBuffer>( 1 )->EndOfFile( ) );
-		return 1;
+		const Format &format = CheckFormat( lua, 2 );
+		lua.CheckStack( static_cast<int>( format.num_values ), "too many values to read" );
+
+		int top = lua.GetTop( );
+		if( !ReadFormat( lua, buffer, format ) )
+		{
+			lua.SetTop( top );
+			return 0;
+		}
+
+		return static_cast<int>( format.num_values );
 	}
 
-	static int getbuffer( lua_State *state )
+	// Writes the arguments after the format of argument 2 with it
+	static int writeformat( Lua::Interface &lua, ByteBuffer &buffer )
 	{
-		Lua::Interface &lua = GetLuaInterface( state );
-		lua.CheckUserdata( 1, metaname );
-		ByteBuffer &buffer = *lua.ToUserdata<ByteBuffer>( 1 );
-		lua.PushString( reinterpret_cast<const char *>( buffer.GetBuffer( ) ), buffer.Size( ) );
-		return 1;
-	}
-}
+		const Format &format = CheckFormat( lua, 2 );
 
-extern "C" int luaopen_bytebuffer( lua_State *state )
-{
-	Lua::Interface &lua = GetLuaInterface( state );
+		int arg = 3;
+		for( size_t n = 0; n < format.num_ops; ++n )
+		{
+			const FormatOp &op = format.ops[n];
+			switch( op.code )
+			{
+			case FORMAT_I8: arg = WriteFormatValues<int8_t>( lua, buffer, op, arg ); break;
+			case FORMAT_U8: arg = WriteFormatValues<uint8_t>( lua, buffer, op, arg ); break;
+			case FORMAT_I16: arg = WriteFormatValues<int16_t>( lua, buffer, op, arg ); break;
+			case FORMAT_U16: arg = WriteFormatValues<uint16_t>( lua, buffer, op, arg ); break;
+			case FORMAT_I32: arg = WriteFormatValues<int32_t>( lua, buffer, op, arg ); break;
+			case FORMAT_U32: arg = WriteFormatValues<uint32_t>( lua, buffer, op, arg ); break;
+			case FORMAT_I64: arg = WriteFormatValues<int64_t>( lua, buffer, op, arg ); break;
+			case FORMAT_U64: arg = WriteFormatValues<uint64_t>( lua, buffer, op, arg ); break;
+			case FORMAT_F32: arg = WriteFormatValues<float>( lua, buffer, op, arg ); break;
+			case FORMAT_F64: arg = WriteFormatValues<double>( lua, buffer, op, arg ); break;
+
+			case FORMAT_STRING:
+				for( uint32_t k = 0; k < op.count; ++k, ++arg )
+				{
+					size_t len = 0;
+					const char *data = lua.CheckStringView( arg, &len );
+
+					// Written up to the first zero, like writestring
+					const void *zero = memchr( data, 0, len );
+					if( zero != nullptr )
+						len = static_cast<size_t>( static_cast<const char *>( zero ) - data );
+
+					CheckWrite( lua, buffer, len + 1 );
+					if( len != 0 )
+						buffer.Write( data, len );
+
+					buffer << '\0';
+				}
 
-	lua.NewMetatable( metaname );
+				break;
 
-	lua.PushFunction( bytebuffer::readinteger );
-	lua.SetField( -2, "readinteger" );
+			case FORMAT_FIXEDSTRING:
+			{
+				// Truncated or padded with zeros to the size of the option
+				size_t len = 0;
+				const char *data = lua.CheckStringView( arg++, &len );
+				if( len > op.count )
+					len = op.count;
 
-	lua.PushFunction( bytebuffer::readfloat );
-	lua.SetField( -2, "readfloat" );
+				CheckWrite( lua, buffer, op.count );
+				if( len != 0 )
+					buffer.Write( data, len );
 
-	lua.PushFunction( bytebuffer::readdouble );
-	lua.SetField( -2, "readdouble" );
+				for( size_t k = len; k < op.count; ++k )
+					buffer << '\0';
 
-	lua.PushFunction( bytebuffer::readbool );
-	lua.SetField( -2, "readbool" );
+				break;
+			}
 
-	lua.PushFunction( bytebuffer::readstring );
-	lua.SetField( -2, "readstring" );
+			case FORMAT_PADDING:
+				CheckWrite( lua, buffer, op.count );
+				for( uint32_t k = 0; k < op.count; ++k )
+					buffer << '\0';
 
-	lua.PushFunction( bytebuffer::writeinteger );
-	lua.SetField( -2, "writeinteger" );
+				break;
+			}
+		}
 
-	lua.PushFunction( bytebuffer::writefloat );
-	lua.SetField( -2, "writefloat" );
+		return 0;
+	}
 
-	lua.PushFunction( bytebuffer::writedouble );
-	lua.SetField( -2, "writedouble" );
+	// Reads up to argument 3 records with the format of argument 2 into
+	// a table, as values for formats of one value or as arrays of values
+	static int readarray( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		const Format &format = CheckFormat( lua, 2 );
+		long long count = lua.CheckInteger( 3 );
+		if( count < 0 || count > INT32_MAX )
+			return lua.ArgError( 3, "invalid number of records" );
 
-	lua.PushFunction( bytebuffer::writebool );
-	lua.SetField( -2, "writebool" );
+		int records = static_cast<int>( count );
+		int values = static_cast<int>( format.num_values );
+		lua.CheckStack( values + 1, "too many values to read" );
 
-	lua.PushFunction( bytebuffer::writestring );
-	lua.SetField( -2, "writestring" );
+		// The table is only preallocated for the records that fit in the
+		// rest of the buffer, the count is just an upper bound
+		size_t remaining = buffer.Tell( ) < buffer.Size( ) ? buffer.Size( ) - buffer.Tell( ) : 0;
+		size_t fit = format.min_size != 0 ? remaining / format.min_size : 0;
+		lua.CreateTable( fit < static_cast<size_t>( records ) ? static_cast<int>( fit ) : records, 0 );
+		int array = lua.GetTop( );
 
-	lua.PushFunction( bytebuffer::assign );
-	lua.SetField( -2, "assign" );
+		int read = 0;
+		for( ; read < records; ++read )
+		{
+			if( !ReadFormat( lua, buffer, format ) )
+			{
+				lua.SetTop( array );
+				break;
+			}
 
-	lua.PushFunction( bytebuffer::reserve );
-	lua.SetField( -2, "reserve" );
+			if( values != 1 )
+			{
+				lua.CreateTable( values, 0 );
+				lua.Insert( -values - 1 );
+				for( int k = values; k >= 1; --k )
+					lua.RawSetI( array + 1, k );
+			}
 
-	lua.PushFunction( bytebuffer::resize );
-	lua.SetField( -2, "resize" );
+			lua.RawSetI( array, read + 1 );
+		}
 
-	lua.PushFunction( bytebuffer::clear );
-	lua.SetField( -2, "clear" );
+		return 1;
+	}
 
-	lua.PushFunction( bytebuffer::tell );
-	lua.SetField( -2, "tell" );
+	static int assign( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		size_t len = 0;
+		const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.CheckStringView( 2, &len ) );
+		CheckResize( lua, buffer );
+		if( len != 0 )
+			buffer.Assign( data, len );
+		else
+			buffer.Clear( );
 
-	lua.PushFunction( bytebuffer::size );
-	lua.SetField( -2, "size" );
+		return 0;
+	}
 
-	lua.PushFunction( bytebuffer::capacity );
-	lua.SetField( -2, "capacity" );
+	static int seek( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		lua.CheckType( 2, Lua::Type::Number );
+		lua.PushBoolean( buffer.Seek( static_cast<int64_t>( lua.ToNumber( 2 ) ) ) );
+		return 1;
+	}
 
-	lua.PushFunction( bytebuffer::shrinktofit );
-	lua.SetField( -2, "shrinktofit" );
+	// Views call their release function once, after clearing their data,
+	// so a slice never points into storage it doesn't pin anymore
+	static void ReleaseSlice( const char *, size_t, void *userdata )
+	{
+		static_cast<ByteBuffer *>( userdata )->Unpin( );
+	}
 
-	lua.PushFunction( bytebuffer::seek );
-	lua.SetField( -2, "seek" );
+	// Returns a string view of argument 3 bytes (or up to the end of the
+	// buffer) from the 0-based offset at argument 2, without copying them.
+	// The view keeps the buffer alive and accepts anything that accepts
+	// string views (like socket sends, hashers or assign).
+	static int slice( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		long long offset = lua.OptionalInteger( 2, 0 );
+		if( offset < 0 || static_cast<unsigned long long>( offset ) > buffer.Size( ) )
+			return lua.ArgError( 2, "offset out of bounds" );
 
-	lua.PushFunction( bytebuffer::isvalid );
-	lua.SetField( -2, "isvalid" );
+		size_t start = static_cast<size_t>( offset );
+		size_t length = buffer.Size( ) - start;
+		if( !lua.IsType( 3, Lua::Type::None ) && !lua.IsType( 3, Lua::Type::Nil ) )
+		{
+			long long requested = lua.CheckInteger( 3 );
+			if( requested < 0 || static_cast<unsigned long long>( requested ) > length )
+				return lua.ArgError( 3, "length out of bounds" );
 
-	lua.PushFunction( bytebuffer::eof );
-	lua.SetField( -2, "eof" );
+			length = static_cast<size_t>( requested );
+		}
 
-	lua.PushFunction( bytebuffer::getbuffer );
-	lua.SetField( -2, "getbuffer" );
+		if( length == 0 )
+		{
+			lua.PushStringView( "", 0 );
+			return 1;
+		}
 
-	lua.PushFunction( bytebuffer::destroy );
-	lua.SetField( -2, "__gc" );
+		buffer.Pin( );
+		lua.PushStringView( reinterpret_cast<const char *>( buffer.GetBuffer( ) ) + start, length, ReleaseSlice, &buffer );
 
-	lua.PushFunction( bytebuffer::tostring );
-	lua.SetField( -2, "__tostring" );
+		lua.CreateTable( 1, 0 );
+		lua.PushValue( 1 );
+		lua.RawSetI( -2, 1 );
+		lua.SetUserValue( -2 );
+		return 1;
+	}
 
-	lua.PushFunction( bytebuffer::index );
-	lua.SetField( -2, "__index" );
+	static int getbuffer( Lua::Interface &lua, ByteBuffer &buffer )
+	{
+		lua.PushString( reinterpret_cast<const char *>( buffer.GetBuffer( ) ), buffer.Size( ) );
+		return 1;
+	}
+}
 
-	lua.PushFunction( bytebuffer::newindex );
-	lua.SetField( -2, "__newindex" );
+typedef int ( *ByteBufferFunction )( Lua::Interface &, ByteBuffer & );
 
-	lua.PushValue( -1 );
-	lua.SetField( -2, "__metatable" );
+// Adds read<suffix> and write<suffix> in native byte order and, for
+// types wider than a byte, <suffix>le and <suffix>be for little and
+// big endian (like readu16be or writef64le)
+template<typename T>
+static void AddValueMethods( Lua::Class<ByteBuffer> &bytebuffer_class, const char *suffix )
+{
+	char name[16];
+	snprintf( name, sizeof( name ), "read%s", suffix );
+	bytebuffer_class.Method( name, &Lua::Method<ByteBufferFunction, &bytebuffer::read<T, BYTEORDER_NATIVE>>::Call );
+	snprintf( name, sizeof( name ), "write%s", suffix );
+	bytebuffer_class.Method( name, &Lua::Method<ByteBufferFunction, &bytebuffer::write<T, BYTEORDER_NATIVE>>::Call );
+
+	if( sizeof( T ) == 1 )
+		return;
+
+	snprintf( name, sizeof( name ), "read%sle", suffix );
+	bytebuffer_class.Method( name, &Lua::Method<ByteBufferFunction, &bytebuffer::read<T, BYTEORDER_LITTLE>>::Call );
+	snprintf( name, sizeof( name ), "write%sle", suffix );
+	bytebuffer_class.Method( name, &Lua::Method<ByteBufferFunction, &bytebuffer::write<T, BYTEORDER_LITTLE>>::Call );
+	snprintf( name, sizeof( name ), "read%sbe", suffix );
+	bytebuffer_class.Method( name, &Lua::Method<ByteBufferFunction, &bytebuffer::read<T, BYTEORDER_BIG>>::Call );
+	snprintf( name, sizeof( name ), "write%sbe", suffix );
+	bytebuffer_class.Method( name, &Lua::Method<ByteBufferFunction, &bytebuffer::write<T, BYTEORDER_BIG>>::Call );
+}
 
-	lua.Pop( 1 );
+extern "C" int luaopen_bytebuffer( lua_State *state )
+{
+	Lua::Interface &lua = GetLuaInterface( state );
 
-	lua.PushFunction( bytebuffer::create );
+	Lua::Class<ByteBuffer> bytebuffer_class( lua, bytebuffer_type );
+	bytebuffer_class
+		.Method( "readinteger", LUAINTERFACE_METHOD( bytebuffer::readinteger ) )
+		.Method( "readfloat", LUAINTERFACE_METHOD( bytebuffer::readfloat ) )
+		.Method( "readdouble", LUAINTERFACE_METHOD( bytebuffer::readdouble ) )
+		.Method( "readbool", LUAINTERFACE_METHOD( bytebuffer::readbool ) )
+		.Method( "readstring", LUAINTERFACE_METHOD( bytebuffer::readstring ) )
+		.Method( "writeinteger", LUAINTERFACE_METHOD( bytebuffer::writeinteger ) )
+		.Method( "writefloat", LUAINTERFACE_METHOD( bytebuffer::writefloat ) )
+		.Method( "writedouble", LUAINTERFACE_METHOD( bytebuffer::writedouble ) )
+		.Method( "writebool", LUAINTERFACE_METHOD( bytebuffer::writebool ) )
+		.Method( "writestring", LUAINTERFACE_METHOD( bytebuffer::writestring ) )
+		.Method( "read", LUAINTERFACE_METHOD( bytebuffer::readformat ) )
+		.Method( "write", LUAINTERFACE_METHOD( bytebuffer::writeformat ) )
+		.Method( "readarray", LUAINTERFACE_METHOD( bytebuffer::readarray ) )
+		.Method( "assign", LUAINTERFACE_METHOD( bytebuffer::assign ) )
+		.Method( "reserve", LUAINTERFACE_METHOD( bytebuffer::reserve ) )
+		.Method( "resize", LUAINTERFACE_METHOD( bytebuffer::resize ) )
+		.Method( "clear", LUAINTERFACE_METHOD( bytebuffer::clear ) )
+		.Method( "tell", LUAINTERFACE_METHOD( ByteBuffer::Tell ) )
+		.Method( "size", LUAINTERFACE_METHOD( ByteBuffer::Size ) )
+		.Method( "capacity", LUAINTERFACE_METHOD( ByteBuffer::Capacity ) )
+		.Method( "shrinktofit", LUAINTERFACE_METHOD( bytebuffer::shrinktofit ) )
+		.Method( "seek", LUAINTERFACE_METHOD( bytebuffer::seek ) )
+		.Method( "isvalid", LUAINTERFACE_METHOD( ByteBuffer::IsValid ) )
+		.Method( "eof", LUAINTERFACE_METHOD( ByteBuffer::EndOfFile ) )
+		.Method( "getbuffer", LUAINTERFACE_METHOD( bytebuffer::getbuffer ) )
+		.Method( "slice", LUAINTERFACE_METHOD( bytebuffer::slice ) )
+		.Method( "__tostring", LUAINTERFACE_METHOD( bytebuffer::tostring ) )
+		.Method( "__index", LUAINTERFACE_METHOD( bytebuffer::index ) )
+		.Method( "__newindex", LUAINTERFACE_METHOD( bytebuffer::newindex ) );
+
+	AddValueMethods<uint8_t>( bytebuffer_class, "u8" );
+	AddValueMethods<int8_t>( bytebuffer_class, "i8" );
+	AddValueMethods<uint16_t>( bytebuffer_class, "u16" );
+	AddValueMethods<int16_t>( bytebuffer_class, "i16" );
+	AddValueMethods<uint32_t>( bytebuffer_class, "u32" );
+	AddValueMethods<int32_t>( bytebuffer_class, "i32" );
+	AddValueMethods<uint64_t>( bytebuffer_class, "u64" );
+	AddValueMethods<int64_t>( bytebuffer_class, "i64" );
+	AddValueMethods<float>( bytebuffer_class, "f32" );
+	AddValueMethods<double>( bytebuffer_class, "f64" );
+
+	lua.CreateTable( 0, 2 );
+	bytebuffer_class.PushFunction( bytebuffer::create );
+	lua.SetField( -2, "new" );
+	bytebuffer_class.PushFunction( bytebuffer::map );
+	lua.SetField( -2, "mmap" );
+
+	lua.CreateTable( 0, 1 );
+	bytebuffer_class.PushFunction( bytebuffer::call );
+	lua.SetField( -2, "__call" );
+	lua.SetMetaTable( -2 );
 	return 1;
 }
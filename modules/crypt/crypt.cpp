@@ -18,7 +18,7 @@
 #define THROW_ERROR( lua, error ) ( lua.ThrowError( error ), 0 )
 #define LUA_ERROR( lua ) THROW_ERROR( lua, lua.ToString( -1 ) )
 
-#define HASHER_METATABLE "hasher"
+static const Lua::TypeTag hasher_type( "hasher" );
 
 #define GET_HASHER( lua, index ) reinterpret_cast<CryptoPP::HashTransformation *>( lua.ToUserdata( index ) )
 
@@ -525,11 +525,11 @@ static int rsaDecrypt( lua_State *state )
 static int hasher__tostring( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 
 	CryptoPP::HashTransformation *hasher = GET_HASHER( lua, 1 );
 	char buffer[30];
-	snprintf( buffer, sizeof( buffer ), "%s: 0x%p", HASHER_METATABLE, hasher );
+	snprintf( buffer, sizeof( buffer ), "%s: 0x%p", hasher_type.GetName( ), hasher );
 	lua.PushString( buffer );
 	return 1;
 }
@@ -537,8 +537,8 @@ static int hasher__tostring( lua_State *state )
 static int hasher__eq( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
-	lua.CheckUserdata( 2, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
+	lua.CheckUserdata( 2, hasher_type );
 
 	lua.PushBoolean( GET_HASHER( lua, 1 ) == GET_HASHER( lua, 2 ) );
 	return 1;
@@ -547,9 +547,9 @@ static int hasher__eq( lua_State *state )
 static int hasher__index( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 
-	lua.NewMetatable( HASHER_METATABLE );
+	lua.GetMetaTable( hasher_type );
 	lua.PushValue( 2 );
 	lua.RawGet( -2 );
 	if( !lua.IsType( -1, Lua::Type::Nil ) )
@@ -566,7 +566,7 @@ static int hasher__index( lua_State *state )
 static int hasher__newindex( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 
 	lua.GetUserValue( 1 );
 	lua.PushValue( 2 );
@@ -578,7 +578,7 @@ static int hasher__newindex( lua_State *state )
 static int hasher__gc( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 
 	CryptoPP::HashTransformation *hasher = GET_HASHER( lua, 1 );
 
@@ -598,13 +598,13 @@ static int hasher__gc( lua_State *state )
 static int hasher_update( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
-	lua.CheckType( 2, Lua::Type::String );
+	lua.CheckUserdata( 1, hasher_type );
 
 	CryptoPP::HashTransformation *hasher = GET_HASHER( lua, 1 );
 
-	uint32_t len = 0;
-	const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.ToString( 2, &len ) );
+	// Strings or string views (like bytebuffer slices), without copies
+	size_t len = 0;
+	const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.CheckStringView( 2, &len ) );
 
 	try
 	{
@@ -622,7 +622,7 @@ static int hasher_update( lua_State *state )
 static int hasher_final( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 
 	CryptoPP::HashTransformation *hasher = GET_HASHER( lua, 1 );
 
@@ -648,7 +648,7 @@ static int hasher_final( lua_State *state )
 static int hasher_restart( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 
 	CryptoPP::HashTransformation *hasher = GET_HASHER( lua, 1 );
 
@@ -668,13 +668,12 @@ static int hasher_restart( lua_State *state )
 static int hasher_digest( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
-	lua.CheckType( 2, Lua::Type::String );
+	lua.CheckUserdata( 1, hasher_type );
 
 	CryptoPP::HashTransformation *hasher = GET_HASHER( lua, 1 );
 
-	uint32_t len = 0;
-	const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.ToString( 2, &len ) );
+	size_t len = 0;
+	const uint8_t *data = reinterpret_cast<const uint8_t *>( lua.CheckStringView( 2, &len ) );
 
 	try
 	{
@@ -698,7 +697,7 @@ static int hasher_digest( lua_State *state )
 static int hasher_name( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 	lua.PushString( GET_HASHER( lua, 1 )->AlgorithmName( ).c_str( ) );
 	return 1;
 }
@@ -706,7 +705,7 @@ static int hasher_name( lua_State *state )
 static int hasher_size( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 	lua.PushNumber( GET_HASHER( lua, 1 )->DigestSize( ) );
 	return 1;
 }
@@ -714,7 +713,7 @@ static int hasher_size( lua_State *state )
 static int hasher_blocksize( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, HASHER_METATABLE );
+	lua.CheckUserdata( 1, hasher_type );
 	lua.PushNumber( GET_HASHER( lua, 1 )->OptimalBlockSize( ) );
 	return 1;
 }
@@ -734,7 +733,7 @@ static int hash_ ## hashType( lua_State *state )						\
 	void *luadata = lua.NewUserdata( sizeof( CryptoPP::hashType ) );	\
 	new( luadata ) CryptoPP::hashType( );								\
 																		\
-	lua.NewMetatable( HASHER_METATABLE );								\
+	lua.GetMetaTable( hasher_type );									\
 	lua.SetMetaTable( -2 );												\
 																		\
 	lua.CreateTable( );													\
@@ -768,7 +767,7 @@ extern "C" int luaopen_crypt( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
 
-	lua.NewMetatable( HASHER_METATABLE );
+	lua.NewMetatable( hasher_type );
 
 	lua.PushValue( -1 );
 	lua.SetField( -2, "__metatable" );
@@ -0,0 +1,11 @@
+project("LuaInterface-Profiler")
+	uuid("bc9db7c0-ab7a-4c55-b17d-bc27a7bd7b08")
+	kind("SharedLib")
+	defines("_CRT_SECURE_NO_WARNINGS")
+	includedirs(INCLUDE_FOLDER)
+	files("*.cpp")
+	vpaths({["Source files"] = "**.cpp"})
+	links("LuaInterface")
+	targetprefix("")
+	targetname("profiler")
+	targetsuffix("")
@@ -0,0 +1,110 @@
+#include <Lua/Interface.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+
+#if defined _WIN32
+
+#define snprintf _snprintf
+
+#endif
+
+namespace profiler
+{
+	static int start( lua_State *state )
+	{
+		Lua::Interface &lua = GetLuaInterface( state );
+		long long frequency = lua.OptionalInteger( 1, 1000 );
+		if( frequency < 1 || frequency > 1000000 )
+			return lua.ArgError( 1, "frequency must be between 1 and 1000000 samples per second" );
+
+		lua.StartProfiler( static_cast<unsigned int>( frequency ) );
+		return 0;
+	}
+
+	static int stop( lua_State *state )
+	{
+		GetLuaInterface( state ).StopProfiler( );
+		return 0;
+	}
+
+	static int clear( lua_State *state )
+	{
+		GetLuaInterface( state ).ClearProfile( );
+		return 0;
+	}
+
+	static int report( lua_State *state )
+	{
+		GetLuaInterface( state ).PushProfile( );
+		return 1;
+	}
+
+	static int dump( lua_State *state )
+	{
+		Lua::Interface &lua = GetLuaInterface( state );
+		if( lua.IsType( 1, Lua::Type::String ) )
+		{
+			const char *path = lua.ToString( 1 );
+			FILE *file = fopen( path, "w" );
+			if( file == nullptr )
+			{
+				lua.PushNil( );
+				lua.PushFormattedString( "cannot open %s: %s", path, strerror( errno ) );
+				return 2;
+			}
+
+			bool written = lua.DumpProfile( file );
+			if( fclose( file ) != 0 || !written )
+			{
+				lua.PushNil( );
+				lua.PushFormattedString( "cannot write %s", path );
+				return 2;
+			}
+
+			lua.PushBoolean( true );
+			return 1;
+		}
+
+		// Without a path, the folded stacks are returned as a string
+		std::string folded;
+		lua.PushProfile( );
+		lua.PushNil( );
+		while( lua.Next( -2 ) != 0 )
+		{
+			char count[32];
+			snprintf( count, sizeof( count ), " %lld\n", static_cast<long long>( lua.ToNumber( -1 ) ) );
+			folded += lua.ToString( -2 );
+			folded += count;
+			lua.Pop( 1 );
+		}
+
+		lua.PushString( folded.c_str( ), folded.size( ) );
+		return 1;
+	}
+}
+
+extern "C" int luaopen_profiler( lua_State *state )
+{
+	Lua::Interface &lua = GetLuaInterface( state );
+
+	lua.CreateTable( );
+
+	lua.PushFunction( profiler::start );
+	lua.SetField( -2, "start" );
+
+	lua.PushFunction( profiler::stop );
+	lua.SetField( -2, "stop" );
+
+	lua.PushFunction( profiler::clear );
+	lua.SetField( -2, "clear" );
+
+	lua.PushFunction( profiler::report );
+	lua.SetField( -2, "report" );
+
+	lua.PushFunction( profiler::dump );
+	lua.SetField( -2, "dump" );
+
+	return 1;
+}
@@ -5,6 +5,7 @@
 #include "lua.h"
 #include "lauxlib.h"
 #include "compat.h"
+#include <Lua/StringView.h>
 
 #include "buffer.h"
 
@@ -76,7 +77,7 @@ int buffer_meth_send(lua_State *L, p_buffer buf) {
     int top = lua_gettop(L);
     int err = IO_DONE;
     size_t size = 0, sent = 0;
-    const char *data = luaL_checklstring(L, 2, &size);
+    const char *data = luainterface_checkstringview(L, 2, &size);
     long start = (long) luaL_optnumber(L, 3, 1);
     long end = (long) luaL_optnumber(L, 4, -1);
     timeout_markstart(buf->tm);
@@ -109,7 +110,7 @@ int buffer_meth_receive(lua_State *L, p_buffer buf) {
     int err = IO_DONE, top = lua_gettop(L);
     luaL_Buffer b;
     size_t size;
-    const char *part = luaL_optlstring(L, 3, "", &size);
+    const char *part = luainterface_optstringview(L, 3, "", &size);
     timeout_markstart(buf->tm);
     /* initialize buffer with optional extra prefix
      * (useful for concatenating previous partial results) */
@@ -8,6 +8,7 @@
 #include "lua.h"
 #include "lauxlib.h"
 #include "compat.h"
+#include <Lua/StringView.h>
 
 #include "auxiliar.h"
 #include "socket.h"
@@ -152,7 +153,7 @@ static int meth_send(lua_State *L) {
     p_timeout tm = &udp->tm;
     size_t count, sent = 0;
     int err;
-    const char *data = luaL_checklstring(L, 2, &count);
+    const char *data = luainterface_checkstringview(L, 2, &count);
     timeout_markstart(tm);
     err = socket_send(&udp->sock, data, count, &sent, tm);
     if (err != IO_DONE) {
@@ -170,7 +171,7 @@ static int meth_send(lua_State *L) {
 static int meth_sendto(lua_State *L) {
     p_udp udp = (p_udp) auxiliar_checkclass(L, "udp{unconnected}", 1);
     size_t count, sent = 0;
-    const char *data = luaL_checklstring(L, 2, &count);
+    const char *data = luainterface_checkstringview(L, 2, &count);
     const char *ip = luaL_checkstring(L, 3);
     const char *port = luaL_checkstring(L, 4);
     p_timeout tm = &udp->tm;
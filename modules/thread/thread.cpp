@@ -16,7 +16,7 @@
 
 #include <stdexcept>
 
-static const char metaname[] = "cthread";
+static const Lua::TypeTag thread_type( "cthread" );
 static const char invalid_object[] = "invalid cthread object";
 
 class LuaThread
@@ -190,7 +190,7 @@ static int thread_create( lua_State *state )
 	LuaThread **userdata = lua.NewUserdata<LuaThread *>( sizeof( LuaThread * ) );
 	*userdata = thread;
 
-	lua.NewMetatable( metaname );
+	lua.GetMetaTable( thread_type );
 	lua.SetMetaTable( -2 );
 
 	return 1;
@@ -199,7 +199,7 @@ static int thread_create( lua_State *state )
 static int thread_destroy( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, metaname );
+	lua.CheckUserdata( 1, thread_type );
 
 	LuaThread **userdata = lua.ToUserdata<LuaThread *>( 1 );
 	LuaThread *thread = *userdata;
@@ -238,7 +238,7 @@ static int thread_sleep( lua_State *state )
 static int thread_join( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, metaname );
+	lua.CheckUserdata( 1, thread_type );
 
 	LuaThread *thread = *lua.ToUserdata<LuaThread *>( 1 );
 	if( thread == nullptr )
@@ -252,7 +252,7 @@ static int thread_join( lua_State *state )
 static int thread_detach( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, metaname );
+	lua.CheckUserdata( 1, thread_type );
 
 	LuaThread *thread = *lua.ToUserdata<LuaThread *>( 1 );
 	if( thread == nullptr )
@@ -266,7 +266,7 @@ static int thread_detach( lua_State *state )
 static int thread_get( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, metaname );
+	lua.CheckUserdata( 1, thread_type );
 	lua.CheckAny( 2 );
 
 	LuaThread *thread = *lua.ToUserdata<LuaThread *>( 1 );
@@ -281,7 +281,7 @@ static int thread_get( lua_State *state )
 static int thread_set( lua_State *state )
 {
 	Lua::Interface &lua = GetLuaInterface( state );
-	lua.CheckUserdata( 1, metaname );
+	lua.CheckUserdata( 1, thread_type );
 	lua.CheckAny( 2 );
 	lua.CheckAny( 3 );
 
@@ -306,7 +306,7 @@ extern "C" int luaopen_thread( lua_State *state )
 	lua.PushFunction( thread_sleep );
 	lua.SetField( -2, "sleep" );
 
-	lua.NewMetatable( metaname );
+	lua.NewMetatable( thread_type );
 
 	lua.CreateTable( );	// __metatable value
 
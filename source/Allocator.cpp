@@ -0,0 +1,289 @@
+#include <Lua/Allocator.hpp>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Lua
+{
+
+static void *SystemReallocate( void *ptr, size_t newsize )
+{
+	if( newsize == 0 )
+	{
+		free( ptr );
+		return nullptr;
+	}
+
+	return realloc( ptr, newsize );
+}
+
+Allocator::~Allocator( )
+{ }
+
+PoolAllocator::PoolAllocator( size_t slab_size ) :
+	slab_size( slab_size > MaxBlockSize ? slab_size : MaxBlockSize ),
+	slab_current( nullptr ),
+	slab_end( nullptr )
+{
+	memset( free_lists, 0, sizeof( free_lists ) );
+}
+
+PoolAllocator::~PoolAllocator( )
+{
+	for( size_t k = 0; k < slabs.size( ); ++k )
+		free( slabs[k] );
+}
+
+size_t PoolAllocator::SizeClass( size_t size )
+{
+	return ( size - 1 ) / Granularity;
+}
+
+void *PoolAllocator::Allocate( size_t size )
+{
+	if( size > MaxBlockSize )
+		return malloc( size );
+
+	size_t sizeclass = SizeClass( size );
+	FreeBlock *block = free_lists[sizeclass];
+	if( block != nullptr )
+	{
+		free_lists[sizeclass] = block->next;
+		return block;
+	}
+
+	size_t blocksize = ( sizeclass + 1 ) * Granularity;
+	if( static_cast<size_t>( slab_end - slab_current ) < blocksize )
+	{
+		// The remainder of the current slab is lost, at most MaxBlockSize bytes
+		uint8_t *slab = static_cast<uint8_t *>( malloc( slab_size ) );
+		if( slab == nullptr )
+			return nullptr;
+
+		try
+		{
+			slabs.push_back( slab );
+		}
+		catch( ... )
+		{
+			free( slab );
+			return nullptr;
+		}
+
+		slab_current = slab;
+		slab_end = slab + slab_size;
+	}
+
+	void *ptr = slab_current;
+	slab_current += blocksize;
+	return ptr;
+}
+
+void PoolAllocator::Free( void *ptr, size_t size )
+{
+	if( size > MaxBlockSize )
+	{
+		free( ptr );
+		return;
+	}
+
+	size_t sizeclass = SizeClass( size );
+	FreeBlock *block = static_cast<FreeBlock *>( ptr );
+	block->next = free_lists[sizeclass];
+	free_lists[sizeclass] = block;
+}
+
+void *PoolAllocator::Reallocate( void *ptr, size_t oldsize, size_t newsize )
+{
+	if( newsize == 0 )
+	{
+		if( ptr != nullptr )
+			Free( ptr, oldsize );
+
+		return nullptr;
+	}
+
+	if( ptr == nullptr )
+		return Allocate( newsize );
+
+	if( oldsize > MaxBlockSize && newsize > MaxBlockSize )
+		return realloc( ptr, newsize );
+
+	if( oldsize <= MaxBlockSize && newsize <= MaxBlockSize && SizeClass( oldsize ) == SizeClass( newsize ) )
+		return ptr;
+
+	// Lua expects shrinking to never fail, the old block is big enough
+	// (a block from malloc then ends up in a free list once freed, and
+	// isn't given back to malloc)
+	void *newptr = Allocate( newsize );
+	if( newptr == nullptr )
+		return newsize < oldsize ? ptr : nullptr;
+
+	memcpy( newptr, ptr, oldsize < newsize ? oldsize : newsize );
+	Free( ptr, oldsize );
+	return newptr;
+}
+
+ArenaAllocator::ArenaAllocator( size_t chunk_size ) :
+	chunk_size( chunk_size ),
+	current( nullptr ),
+	usage( 0 )
+{ }
+
+ArenaAllocator::~ArenaAllocator( )
+{
+	while( current != nullptr )
+	{
+		Chunk *previous = current->previous;
+		free( current );
+		current = previous;
+	}
+}
+
+size_t ArenaAllocator::Align( size_t size )
+{
+	return ( size + Alignment - 1 ) & ~( Alignment - 1 );
+}
+
+uint8_t *ArenaAllocator::Top( ) const
+{
+	return reinterpret_cast<uint8_t *>( current ) + Align( sizeof( Chunk ) ) + current->used;
+}
+
+void *ArenaAllocator::Allocate( size_t size )
+{
+	size = Align( size );
+	if( current == nullptr || current->size - current->used < size )
+	{
+		size_t capacity = size > chunk_size ? size : chunk_size;
+		Chunk *chunk = static_cast<Chunk *>( malloc( Align( sizeof( Chunk ) ) + capacity ) );
+		if( chunk == nullptr )
+			return nullptr;
+
+		chunk->previous = current;
+		chunk->size = capacity;
+		chunk->used = 0;
+		current = chunk;
+	}
+
+	void *ptr = Top( );
+	current->used += size;
+	usage += size;
+	return ptr;
+}
+
+void *ArenaAllocator::Reallocate( void *ptr, size_t oldsize, size_t newsize )
+{
+	size_t aligned_oldsize = Align( oldsize );
+	bool trailing = ptr != nullptr && static_cast<uint8_t *>( ptr ) + aligned_oldsize == Top( );
+
+	if( newsize == 0 )
+	{
+		if( trailing )
+		{
+			current->used -= aligned_oldsize;
+			usage -= aligned_oldsize;
+		}
+
+		return nullptr;
+	}
+
+	if( ptr == nullptr )
+		return Allocate( newsize );
+
+	size_t aligned_newsize = Align( newsize );
+	if( aligned_newsize <= aligned_oldsize )
+	{
+		if( trailing )
+		{
+			current->used -= aligned_oldsize - aligned_newsize;
+			usage -= aligned_oldsize - aligned_newsize;
+		}
+
+		return ptr;
+	}
+
+	if( trailing && current->size - current->used >= aligned_newsize - aligned_oldsize )
+	{
+		current->used += aligned_newsize - aligned_oldsize;
+		usage += aligned_newsize - aligned_oldsize;
+		return ptr;
+	}
+
+	void *newptr = Allocate( newsize );
+	if( newptr == nullptr )
+		return nullptr;
+
+	memcpy( newptr, ptr, oldsize );
+	return newptr;
+}
+
+void ArenaAllocator::Reset( )
+{
+	if( current == nullptr )
+		return;
+
+	while( current->previous != nullptr )
+	{
+		Chunk *previous = current->previous;
+		free( current );
+		current = previous;
+	}
+
+	current->used = 0;
+	usage = 0;
+}
+
+size_t ArenaAllocator::GetUsage( ) const
+{
+	return usage;
+}
+
+LimitedAllocator::LimitedAllocator( size_t limit, Allocator *parent ) :
+	parent( parent ),
+	limit( limit ),
+	usage( 0 ),
+	peak_usage( 0 )
+{ }
+
+void *LimitedAllocator::Reallocate( void *ptr, size_t oldsize, size_t newsize )
+{
+	if( ptr == nullptr )
+		oldsize = 0;
+
+	if( newsize > oldsize && newsize - oldsize > limit - ( usage < limit ? usage : limit ) )
+		return nullptr;
+
+	void *newptr = parent != nullptr ?
+		parent->Reallocate( ptr, oldsize, newsize ) :
+		SystemReallocate( ptr, newsize );
+	if( newptr == nullptr && newsize != 0 )
+		return nullptr;
+
+	usage = usage - oldsize + newsize;
+	if( usage > peak_usage )
+		peak_usage = usage;
+
+	return newptr;
+}
+
+size_t LimitedAllocator::GetLimit( ) const
+{
+	return limit;
+}
+
+void LimitedAllocator::SetLimit( size_t limit )
+{
+	this->limit = limit;
+}
+
+size_t LimitedAllocator::GetUsage( ) const
+{
+	return usage;
+}
+
+size_t LimitedAllocator::GetPeakUsage( ) const
+{
+	return peak_usage;
+}
+
+}
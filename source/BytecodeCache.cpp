@@ -0,0 +1,279 @@
+#include <lua.hpp>
+#include <Lua/BytecodeCache.hpp>
+#include <Lua/Interface.hpp>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <thread>
+
+#if defined _WIN32
+
+#define stat _stat64
+#define snprintf _snprintf
+
+#endif
+
+namespace Lua
+{
+
+static const char DiskMagic[4] = { 'L', 'I', 'B', 'C' };
+
+#if defined LUAJIT_VERSION_NUM
+
+static const uint32_t DiskVersion = LUAJIT_VERSION_NUM;
+
+#else
+
+static const uint32_t DiskVersion = LUA_VERSION_NUM;
+
+#endif
+
+struct DiskHeader
+{
+	char magic[4];
+	uint32_t version;
+	int64_t mtime;
+	uint64_t size;
+	uint64_t hash;
+	uint64_t length;
+};
+
+// 64-bit FNV-1a
+static uint64_t Hash( const char *data, size_t len )
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for( size_t k = 0; k < len; ++k )
+	{
+		hash ^= static_cast<uint8_t>( data[k] );
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static bool ReadFile( const char *path, std::string &contents )
+{
+	FILE *file = fopen( path, "rb" );
+	if( file == nullptr )
+		return false;
+
+	char buffer[BufferSize];
+	size_t read = 0;
+	while( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) != 0 )
+		contents.append( buffer, read );
+
+	bool failed = ferror( file ) != 0;
+	fclose( file );
+	return !failed;
+}
+
+static int FileError( Interface &lua, const char *what, const char *path )
+{
+	lua.PushFormattedString( "cannot %s %s: %s", what, path, strerror( errno ) );
+	return LUA_ERRFILE;
+}
+
+BytecodeCache::BytecodeCache( )
+{ }
+
+BytecodeCache::BytecodeCache( const char *directory ) :
+	directory( directory )
+{ }
+
+int BytecodeCache::Load( Interface &lua, const char *path )
+{
+	struct stat info;
+	if( stat( path, &info ) != 0 )
+		return FileError( lua, "open", path );
+
+	std::string chunkname( "@" );
+	chunkname += path;
+
+	std::string key( path );
+	int64_t mtime = static_cast<int64_t>( info.st_mtime );
+	uint64_t size = static_cast<uint64_t>( info.st_size );
+
+	Bytecode bytecode = Find( key, mtime, size );
+	uint64_t hash = 0;
+	std::string source;
+	if( !bytecode )
+	{
+		Entry entry;
+		if( ReadDisk( key, entry ) && entry.mtime == mtime && entry.size == size )
+		{
+			bytecode = entry.bytecode;
+			Store( key, entry );
+		}
+		else
+		{
+			if( !ReadFile( path, source ) )
+				return FileError( lua, "read", path );
+
+			hash = Hash( source.data( ), source.size( ) );
+			bytecode = FindHash( key, mtime, size, hash );
+			if( !bytecode && entry.bytecode && entry.hash == hash )
+			{
+				bytecode = entry.bytecode;
+				entry.mtime = mtime;
+				entry.size = size;
+				Store( key, entry );
+				WriteDisk( key, entry );
+			}
+		}
+	}
+
+	if( bytecode )
+	{
+		int status = lua.LoadBuffer( reinterpret_cast<const char *>( bytecode->data( ) ), bytecode->size( ), chunkname.c_str( ) );
+		if( status == 0 )
+			return 0;
+
+		// Stale or corrupted bytecode, compile the file again
+		lua.Pop( 1 );
+		if( source.empty( ) )
+		{
+			if( !ReadFile( path, source ) )
+				return FileError( lua, "read", path );
+
+			hash = Hash( source.data( ), source.size( ) );
+		}
+	}
+
+	// Skip a UTF-8 BOM and then the first line if it's a comment (like
+	// #!/usr/bin/lua), keeping the line count, like luaL_loadfile
+	size_t offset = 0;
+	if( source.compare( 0, 3, "\xEF\xBB\xBF" ) == 0 )
+		offset = 3;
+
+	if( offset < source.size( ) && source[offset] == '#' )
+	{
+		offset = source.find( '\n', offset );
+		if( offset == std::string::npos )
+			offset = source.size( );
+	}
+
+	int status = lua.LoadBuffer( source.data( ) + offset, source.size( ) - offset, chunkname.c_str( ) );
+	if( status != 0 )
+		return status;
+
+	std::shared_ptr<std::vector<uint8_t> > dumped = std::make_shared<std::vector<uint8_t> >( );
+	if( !lua.Dump( *dumped ) )
+		return 0;
+
+	Entry entry;
+	entry.mtime = mtime;
+	entry.size = size;
+	entry.hash = hash;
+	entry.bytecode = dumped;
+
+	Store( key, entry );
+	WriteDisk( key, entry );
+	return 0;
+}
+
+void BytecodeCache::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	entries.clear( );
+}
+
+BytecodeCache::Bytecode BytecodeCache::Find( const std::string &path, int64_t mtime, uint64_t size )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	std::unordered_map<std::string, Entry>::iterator it = entries.find( path );
+	if( it == entries.end( ) || it->second.mtime != mtime || it->second.size != size )
+		return Bytecode( );
+
+	return it->second.bytecode;
+}
+
+BytecodeCache::Bytecode BytecodeCache::FindHash( const std::string &path, int64_t mtime, uint64_t size, uint64_t hash )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	std::unordered_map<std::string, Entry>::iterator it = entries.find( path );
+	if( it == entries.end( ) || it->second.hash != hash )
+		return Bytecode( );
+
+	// Touched but unchanged, refresh the entry so the next load doesn't hash it again
+	it->second.mtime = mtime;
+	it->second.size = size;
+	return it->second.bytecode;
+}
+
+void BytecodeCache::Store( const std::string &path, const Entry &entry )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	entries[path] = entry;
+}
+
+std::string BytecodeCache::GetDiskPath( const std::string &path ) const
+{
+	char name[32];
+	snprintf( name, sizeof( name ), "/%016llx.luac", static_cast<unsigned long long>( Hash( path.data( ), path.size( ) ) ) );
+	return directory + name;
+}
+
+bool BytecodeCache::ReadDisk( const std::string &path, Entry &entry ) const
+{
+	if( directory.empty( ) )
+		return false;
+
+	std::string contents;
+	if( !ReadFile( GetDiskPath( path ).c_str( ), contents ) || contents.size( ) < sizeof( DiskHeader ) )
+		return false;
+
+	DiskHeader header;
+	memcpy( &header, contents.data( ), sizeof( header ) );
+	if( memcmp( header.magic, DiskMagic, sizeof( DiskMagic ) ) != 0 || header.version != DiskVersion ||
+		header.length != contents.size( ) - sizeof( header ) )
+		return false;
+
+	entry.mtime = header.mtime;
+	entry.size = header.size;
+	entry.hash = header.hash;
+	entry.bytecode = std::make_shared<const std::vector<uint8_t> >( contents.begin( ) + sizeof( header ), contents.end( ) );
+	return true;
+}
+
+void BytecodeCache::WriteDisk( const std::string &path, const Entry &entry ) const
+{
+	if( directory.empty( ) )
+		return;
+
+	DiskHeader header;
+	memcpy( header.magic, DiskMagic, sizeof( DiskMagic ) );
+	header.version = DiskVersion;
+	header.mtime = entry.mtime;
+	header.size = entry.size;
+	header.hash = entry.hash;
+	header.length = entry.bytecode->size( );
+
+	// Write to a temporary file first, so concurrent readers never see half a file
+	std::string diskpath = GetDiskPath( path );
+	char suffix[32];
+	snprintf( suffix, sizeof( suffix ), ".%llx.tmp", static_cast<unsigned long long>( std::hash<std::thread::id>( )( std::this_thread::get_id( ) ) ) );
+	std::string temppath = diskpath + suffix;
+	FILE *file = fopen( temppath.c_str( ), "wb" );
+	if( file == nullptr )
+		return;
+
+	bool written = fwrite( &header, sizeof( header ), 1, file ) == 1 &&
+		fwrite( entry.bytecode->data( ), 1, entry.bytecode->size( ), file ) == entry.bytecode->size( );
+	if( fclose( file ) != 0 || !written )
+	{
+		remove( temppath.c_str( ) );
+		return;
+	}
+
+#if defined _WIN32
+
+	remove( diskpath.c_str( ) );
+
+#endif
+
+	if( rename( temppath.c_str( ), diskpath.c_str( ) ) != 0 )
+		remove( temppath.c_str( ) );
+}
+
+}
@@ -1,8 +1,15 @@
 #include <lua.hpp>
 #include <Lua/Interface.hpp>
+#include <Lua/InterfaceInline.hpp>
 #include <Internal.hpp>
-#include <Reference.hpp>
+#include <Profiler.hpp>
+#include <MetricCounters.hpp>
+#include <Lua/StringView.h>
 #include <stdexcept>
+#include <new>
+#include <climits>
+#include <math.h>
+#include <string.h>
 
 #if defined LUAJIT_VERSION
 
@@ -48,14 +55,28 @@ LUA_EXTERN const char *luai_moduleunloadfunc = __STRINGIFY( LUA_MODULE_UNLOAD_NA
 #undef __STRINGIFY
 #undef __STRINGIFY2
 
-LUA_EXTERN void luai_userstatethread( lua_State *global, lua_State *state )
+// Thread Interface objects are only created when requested, see Interface::CreateThreadInterface
+LUA_EXTERN void luai_userstatethread( lua_State *, lua_State *state )
 {
-	Lua::UserstateCreated( global, state );
+	Lua::Internal::SetLuaInterface( state, nullptr );
 }
 
 LUA_EXTERN void luai_userstatefree( lua_State *, lua_State *state )
 {
-	delete &GetLuaInterface( state );
+	delete Lua::Internal::GetLuaInterface( state );
+}
+
+// Provided by the patched loadlib.c (lib_package.c on LuaJIT)
+LUA_EXTERN int luai_reloadlib( lua_State *state, const char *path, const char *symbol, int nargs );
+
+LUA_EXTERN void luai_userstategcbegin( lua_State *state )
+{
+	Lua::MetricCounters::CollectorStarted( state );
+}
+
+LUA_EXTERN void luai_userstategcend( lua_State *state )
+{
+	Lua::MetricCounters::CollectorFinished( state );
 }
 
 static int LuaPanic( lua_State *state )
@@ -67,116 +88,416 @@ static int LuaPanic( lua_State *state )
 namespace Lua
 {
 
-static void UserstateCreated( lua_State *global, lua_State *state )
+static const char ReleaseSentinelName[] = "LuaInterface.ReleaseSentinel";
+
+struct LibraryEntry
 {
-	new Interface( state, global );
+	Library library;
+	const char *name;
+	Function open;
+};
+
+// Same order as luaL_openlibs
+static const LibraryEntry Libraries[] = {
+
+#if defined LUAJIT_VERSION
+
+	{ Library::Base, "", luaopen_base },
+
+#elif LUA_VERSION_NUM >= 502
+
+	{ Library::Base, "_G", luaopen_base },
+
+#else
+
+	{ Library::Base, "", luaopen_base },
+
+#endif
+
+	{ Library::Package, LUA_LOADLIBNAME, luaopen_package },
+
+#if LUA_VERSION_NUM >= 502
+
+	{ Library::Coroutine, LUA_COLIBNAME, luaopen_coroutine },
+
+#endif
+
+	{ Library::Table, LUA_TABLIBNAME, luaopen_table },
+	{ Library::IO, LUA_IOLIBNAME, luaopen_io },
+	{ Library::OS, LUA_OSLIBNAME, luaopen_os },
+	{ Library::String, LUA_STRLIBNAME, luaopen_string },
+	{ Library::Math, LUA_MATHLIBNAME, luaopen_math },
+
+#if LUA_VERSION_NUM >= 503
+
+	{ Library::UTF8, LUA_UTF8LIBNAME, luaopen_utf8 },
+
+#endif
+
+	{ Library::Debug, LUA_DBLIBNAME, luaopen_debug },
+
+#if defined LUAJIT_VERSION
+
+	{ Library::Bit, LUA_BITLIBNAME, luaopen_bit },
+	{ Library::JIT, LUA_JITLIBNAME, luaopen_jit },
+
+#elif defined LUA_COMPAT_BITLIB
+
+	{ Library::Bit, LUA_BITLIBNAME, luaopen_bit32 },
+
+#endif
+
+};
+
+static bool HasLibrary( Library set, Library library )
+{
+	return ( set & library ) != Library::None;
 }
 
-const char *Interface::Version( )
+// Opens a library like luaL_openlibs does and pushes its table
+static void OpenLibrary( lua_State *state, const char *name, lua_CFunction open )
 {
 
-#ifdef LUAJIT_VERSION
+#if LUA_VERSION_NUM >= 502
 
-	return LUAJIT_VERSION;
+	luaL_requiref( state, name, open, 1 );
 
 #else
 
-	return LUA_VERSION;
+	lua_pushcfunction( state, open );
+	lua_pushstring( state, name );
+	lua_call( state, 1, 1 );
 
 #endif
 
 }
 
-int Interface::VersionNumber( )
+static void PushPreloadTable( lua_State *state )
 {
 
-#ifdef LUAJIT_VERSION_NUM
+#if LUA_VERSION_NUM >= 502
 
-	return LUAJIT_VERSION_NUM;
+	luaL_getsubtable( state, LUA_REGISTRYINDEX, "_PRELOAD" );
 
 #else
 
-	return LUA_VERSION_NUM;
+	luaL_findtable( state, LUA_REGISTRYINDEX, "_PRELOAD", 1 );
 
 #endif
 
 }
 
-Interface::Interface( ) :
-	lua_state( luaL_newstate( ) ), global_state( nullptr )
+// __index of the globals table, upvalue 1 maps global names to the functions opening them
+static int OpenLazyLibrary( lua_State *state )
 {
-	Internal::SetLuaInterface( lua_state, this );
+	lua_pushvalue( state, 2 );
+	lua_rawget( state, lua_upvalueindex( 1 ) );
+	lua_CFunction open = lua_tocfunction( state, -1 );
+	if( open == nullptr )
+		return 1;
 
-#if defined LUAJIT_VERSION && defined _WIN32 && !defined _WIN64
+	lua_pop( state, 1 );
+	lua_pushvalue( state, 2 );
+	lua_pushnil( state );
+	lua_rawset( state, lua_upvalueindex( 1 ) );
 
-	lua_pushlightuserdata( lua_state, SafeLuaFunction );
-	luaJIT_setmode( lua_state, -1, LUAJIT_MODE_WRAPCFUNC | LUAJIT_MODE_ON );
+	// It might have been loaded through require already
+	lua_getfield( state, LUA_REGISTRYINDEX, "_LOADED" );
+	lua_pushvalue( state, 2 );
+	lua_rawget( state, -2 );
+	if( lua_isnil( state, -1 ) )
+	{
+		lua_pop( state, 1 );
+		OpenLibrary( state, lua_tostring( state, 2 ), open );
+	}
+
+	lua_pushvalue( state, 2 );
+	lua_pushvalue( state, -2 );
+	lua_rawset( state, 1 );
+	return 1;
+}
+
+// __index of strings until String is opened, opens it through the
+// globals table (which replaces this metatable) and indexes it
+static int OpenLazyString( lua_State *state )
+{
+
+#if LUA_VERSION_NUM >= 502
+
+	lua_pushglobaltable( state );
+
+#else
+
+	lua_pushvalue( state, LUA_GLOBALSINDEX );
 
 #endif
 
-	lua_atpanic( lua_state, LuaPanic );
+	lua_getfield( state, -1, LUA_STRLIBNAME );
+	lua_settop( state, 2 );
 
-	luaL_openlibs( lua_state );
+	// The library might not open (like when the globals table
+	// metatable was replaced), strings have no methods then
+	lua_getmetatable( state, 1 );
+	lua_getfield( state, -1, "__index" );
+	if( lua_tocfunction( state, -1 ) == OpenLazyString )
+	{
+		lua_pushnil( state );
+		return 1;
+	}
+
+	lua_settop( state, 2 );
+	lua_gettable( state, 1 );
+	return 1;
 }
 
-Interface::Interface( lua_State *state, lua_State *global ) :
-	lua_state( state ), global_state( global )
+static void OpenLibraries( lua_State *state, Library libraries, Library lazy )
 {
-	Internal::SetLuaInterface( lua_state, this );
+	// Base and Package (which provides require) can't be lazy
+	libraries = libraries | ( lazy & ( Library::Base | Library::Package ) );
+	lazy = lazy & ~libraries;
+
+	int lazy_count = 0;
+	for( size_t k = 0; k < sizeof( Libraries ) / sizeof( *Libraries ); ++k )
+	{
+		const LibraryEntry &entry = Libraries[k];
+		if( HasLibrary( libraries, entry.library ) )
+		{
+			OpenLibrary( state, entry.name, entry.open );
+			lua_pop( state, 1 );
+		}
+		else if( HasLibrary( lazy, entry.library ) )
+		{
+			++lazy_count;
+		}
+	}
+
+#if defined LUAJIT_VERSION && !defined LUAJIT_DISABLE_FFI
+
+	// LuaJIT only preloads ffi, which already makes it lazy
+	if( HasLibrary( libraries | lazy, Library::FFI ) )
+	{
+		PushPreloadTable( state );
+		lua_pushcfunction( state, luaopen_ffi );
+		lua_setfield( state, -2, LUA_FFILIBNAME );
+		lua_pop( state, 1 );
+	}
+
+#endif
+
+	if( lazy_count == 0 )
+		return;
+
+	bool preload = HasLibrary( libraries, Library::Package );
+	if( preload )
+		PushPreloadTable( state );
+
+	lua_createtable( state, 0, lazy_count );
+	for( size_t k = 0; k < sizeof( Libraries ) / sizeof( *Libraries ); ++k )
+	{
+		const LibraryEntry &entry = Libraries[k];
+		if( !HasLibrary( lazy, entry.library ) )
+			continue;
+
+		lua_pushcfunction( state, entry.open );
+		if( preload )
+		{
+			lua_pushvalue( state, -1 );
+			lua_setfield( state, -4, entry.name );
+		}
+
+		lua_setfield( state, -2, entry.name );
+	}
+
+	lua_createtable( state, 0, 1 );
+	lua_insert( state, -2 );
+	lua_pushcclosure( state, OpenLazyLibrary, 1 );
+	lua_setfield( state, -2, "__index" );
+
+#if LUA_VERSION_NUM >= 502
+
+	lua_pushglobaltable( state );
+
+#else
+
+	lua_pushvalue( state, LUA_GLOBALSINDEX );
+
+#endif
+
+	lua_insert( state, -2 );
+	lua_setmetatable( state, -2 );
+	lua_pop( state, preload ? 2 : 1 );
+
+	// Methods of strings go through their metatable, which String
+	// sets when it's opened, so until then a placeholder opens it
+	if( HasLibrary( lazy, Library::String ) )
+	{
+		lua_pushliteral( state, "" );
+		lua_createtable( state, 0, 1 );
+		lua_pushcfunction( state, OpenLazyString );
+		lua_setfield( state, -2, "__index" );
+		lua_setmetatable( state, -2 );
+		lua_pop( state, 1 );
+	}
 }
 
-Interface::~Interface( )
+static void CreateReleaseSentinel( lua_State *state )
 {
-	if( global_state == nullptr )
-		lua_close( lua_state );
+	lua_newuserdata( state, 1 );
+	luaL_getmetatable( state, ReleaseSentinelName );
+	lua_setmetatable( state, -2 );
+	lua_pop( state, 1 );
+}
+
+Interface &Interface::CreateThreadInterface( lua_State *state )
+{
+	return *new Interface( state, Internal::GetMainThread( state ) );
+}
+
+const char *Interface::Version( )
+{
+
+#ifdef LUAJIT_VERSION
+
+	return LUAJIT_VERSION;
+
+#else
+
+	return LUA_VERSION;
+
+#endif
 
-	lua_state = nullptr;
-	global_state = nullptr;
 }
 
-lua_State *Interface::GetLuaState( ) const
+int Interface::VersionNumber( )
 {
-	return lua_state;
+
+#ifdef LUAJIT_VERSION_NUM
+
+	return LUAJIT_VERSION_NUM;
+
+#else
+
+	return LUA_VERSION_NUM;
+
+#endif
+
 }
 
-int Interface::GetTop( )
+static void *AllocatorFunction( void *userdata, void *ptr, size_t oldsize, size_t newsize )
 {
-	return lua_gettop( lua_state );
+	return static_cast<Allocator *>( userdata )->Reallocate( ptr, ptr != nullptr ? oldsize : 0, newsize );
 }
 
-void Interface::SetTop( int num )
+Interface::Interface( ) :
+	lua_state( luaL_newstate( ) ), global_state( nullptr ),
+	reference_table( ReferenceInvalid ), object_count( 0 ),
+	foreign_releases( nullptr ), overflow_count( 0 ), bytecode_cache( nullptr ),
+	profiler( nullptr ), metrics( nullptr )
 {
-	lua_settop( lua_state, num );
+	Initialize( Library::All, Library::None );
 }
 
-void Interface::Pop( int amount )
+Interface::Interface( Allocator &allocator ) :
+	lua_state( lua_newstate( AllocatorFunction, &allocator ) ), global_state( nullptr ),
+	reference_table( ReferenceInvalid ), object_count( 0 ),
+	foreign_releases( nullptr ), overflow_count( 0 ), bytecode_cache( nullptr ),
+	profiler( nullptr ), metrics( nullptr )
 {
-	lua_pop( lua_state, amount );
+	if( lua_state == nullptr )
+		throw std::runtime_error( "Unable to create Lua state with custom allocator!" );
+
+	Initialize( Library::All, Library::None );
 }
 
-void Interface::CreateTable( int array_elems, int nonarray_elems )
+Interface::Interface( Library libraries, Library lazy ) :
+	lua_state( luaL_newstate( ) ), global_state( nullptr ),
+	reference_table( ReferenceInvalid ), object_count( 0 ),
+	foreign_releases( nullptr ), overflow_count( 0 ), bytecode_cache( nullptr ),
+	profiler( nullptr ), metrics( nullptr )
 {
-	lua_createtable( lua_state, array_elems, nonarray_elems );
+	Initialize( libraries, lazy );
 }
 
-void Interface::GetTable( int stackpos )
+Interface::Interface( Allocator &allocator, Library libraries, Library lazy ) :
+	lua_state( lua_newstate( AllocatorFunction, &allocator ) ), global_state( nullptr ),
+	reference_table( ReferenceInvalid ), object_count( 0 ),
+	foreign_releases( nullptr ), overflow_count( 0 ), bytecode_cache( nullptr ),
+	profiler( nullptr ), metrics( nullptr )
 {
-	lua_gettable( lua_state, stackpos );
+	if( lua_state == nullptr )
+		throw std::runtime_error( "Unable to create Lua state with custom allocator!" );
+
+	Initialize( libraries, lazy );
 }
 
-void Interface::SetTable( int stackpos )
+Interface::Interface( lua_State *state, lua_State *global ) :
+	lua_state( state ), global_state( global ),
+	reference_table( ReferenceInvalid ), object_count( 0 ),
+	foreign_releases( nullptr ), overflow_count( 0 ), bytecode_cache( nullptr ),
+	profiler( nullptr ), metrics( nullptr )
 {
-	lua_settable( lua_state, stackpos );
+	Internal::SetLuaInterface( lua_state, this );
 }
 
-void Interface::GetField( int stackpos, const char *strName )
+Interface::~Interface( )
 {
-	lua_getfield( lua_state, stackpos, strName );
+	if( global_state == nullptr )
+	{
+		// Keep the release sentinel from re-arming itself while closing
+		luaL_getmetatable( lua_state, ReleaseSentinelName );
+		lua_pushnil( lua_state );
+		lua_setfield( lua_state, -2, "__gc" );
+		lua_pop( lua_state, 1 );
+
+		// Finalizers run by lua_close might still reach the profiler hook
+		delete profiler;
+		profiler = nullptr;
+
+		lua_close( lua_state );
+
+		// The counting allocator is used until the state is closed
+		delete metrics;
+		metrics = nullptr;
+
+		ForeignRelease *node = foreign_releases.exchange( nullptr );
+		while( node != nullptr )
+		{
+			ForeignRelease *next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+
+	lua_state = nullptr;
+	global_state = nullptr;
 }
 
-void Interface::SetField( int stackpos, const char *strName )
+void Interface::Initialize( Library libraries, Library lazy )
 {
-	lua_setfield( lua_state, stackpos, strName );
+	Internal::SetLuaInterface( lua_state, this );
+
+	released_references.reserve( ReferenceReleaseBatch );
+	owner_thread.store( std::this_thread::get_id( ) );
+	metrics = new MetricCounters( lua_state );
+
+#if defined LUAJIT_VERSION && defined _WIN32 && !defined _WIN64
+
+	lua_pushlightuserdata( lua_state, SafeLuaFunction );
+	luaJIT_setmode( lua_state, -1, LUAJIT_MODE_WRAPCFUNC | LUAJIT_MODE_ON );
+
+#endif
+
+	lua_atpanic( lua_state, LuaPanic );
+
+	OpenLibraries( lua_state, libraries, lazy );
+
+	luaL_newmetatable( lua_state, ReleaseSentinelName );
+	lua_pushlightuserdata( lua_state, this );
+	lua_pushcclosure( lua_state, ReleaseSentinelCollected, 1 );
+	lua_setfield( lua_state, -2, "__gc" );
+	lua_pop( lua_state, 1 );
+
+	CreateReleaseSentinel( lua_state );
 }
 
 int Interface::Next( int stackpos )
@@ -194,9 +515,38 @@ void Interface::GetMetaTable( const char *name )
 	luaL_getmetatable( lua_state, name );
 }
 
-int Interface::GetMetaTable( int stackpos )
+int Interface::NewMetatable( const TypeTag &tag )
 {
-	return lua_getmetatable( lua_state, stackpos );
+	Interface &main = GetMainInterface( );
+	size_t id = tag.GetID( );
+	if( id < main.types.size( ) && main.types[id].metatable != nullptr )
+	{
+		lua_rawgeti( lua_state, LUA_REGISTRYINDEX, main.types[id].reference );
+		return 0;
+	}
+
+	int created = luaL_newmetatable( lua_state, tag.GetName( ) );
+
+	if( id >= main.types.size( ) )
+	{
+		TypeEntry entry = { nullptr, ReferenceInvalid };
+		main.types.resize( id + 1, entry );
+	}
+
+	lua_pushvalue( lua_state, -1 );
+	main.types[id].reference = luaL_ref( lua_state, LUA_REGISTRYINDEX );
+	main.types[id].metatable = lua_topointer( lua_state, -1 );
+	return created;
+}
+
+void Interface::GetMetaTable( const TypeTag &tag )
+{
+	Interface &main = GetMainInterface( );
+	size_t id = tag.GetID( );
+	if( id < main.types.size( ) && main.types[id].metatable != nullptr )
+		lua_rawgeti( lua_state, LUA_REGISTRYINDEX, main.types[id].reference );
+	else
+		lua_pushnil( lua_state );
 }
 
 int Interface::GetMetaTableField( int stackpos, const char *strName )
@@ -216,7 +566,17 @@ void Interface::Call( int args, int results )
 
 int Interface::PCall( int args, int results, int errorfuncpos )
 {
-	return lua_pcall( lua_state, args, results, errorfuncpos );
+	Interface &main = GetMainInterface( );
+	if( main.foreign_releases.load( std::memory_order_relaxed ) != nullptr || main.overflow_count.load( std::memory_order_relaxed ) != 0 )
+	{
+		main.DrainForeignReleases( );
+		if( main.released_references.size( ) >= ReferenceReleaseBatch )
+			FlushReferences( );
+	}
+
+	int status = lua_pcall( lua_state, args, results, errorfuncpos );
+	main.metrics->CountCall( lua_state, status );
+	return status;
 }
 
 int Interface::CallMeta( int stackpos, const char *strName )
@@ -257,19 +617,162 @@ int Interface::SetUserValue( int stackpos )
 
 }
 
-void Interface::Insert( int stackpos )
+size_t Interface::RawLen( int stackpos )
 {
-	lua_insert( lua_state, stackpos );
+
+#if LUA_VERSION_NUM >= 502
+
+	return lua_rawlen( lua_state, stackpos );
+
+#else
+
+	return lua_objlen( lua_state, stackpos );
+
+#endif
+
 }
 
-void Interface::Remove( int stackpos )
+#if LUA_VERSION_NUM >= 503
+
+typedef lua_Integer ArrayIndex;
+
+#else
+
+typedef int ArrayIndex;
+
+#endif
+
+// Pseudo-indices are left as they are
+static int AbsoluteIndex( lua_State *state, int index )
 {
-	lua_remove( lua_state, stackpos );
+	return index < 0 && -index <= lua_gettop( state ) ? lua_gettop( state ) + index + 1 : index;
 }
 
-void Interface::Replace( int stackpos )
+static bool ToArrayElement( lua_State *state, double &value )
 {
-	return lua_replace( lua_state, stackpos );
+	if( lua_isnumber( state, -1 ) == 0 )
+		return false;
+
+	value = lua_tonumber( state, -1 );
+	return true;
+}
+
+static bool ToArrayElement( lua_State *state, long long &value )
+{
+
+#if LUA_VERSION_NUM >= 503
+
+	int isnum = 0;
+	value = lua_tointegerx( state, -1, &isnum );
+	return isnum != 0;
+
+#else
+
+	if( lua_isnumber( state, -1 ) == 0 )
+		return false;
+
+	value = lua_tointeger( state, -1 );
+	return true;
+
+#endif
+
+}
+
+static void PushArrayElement( lua_State *state, double value )
+{
+	lua_pushnumber( state, value );
+}
+
+static void PushArrayElement( lua_State *state, long long value )
+{
+	lua_pushinteger( state, static_cast<lua_Integer>( value ) );
+}
+
+// Elements out of the array part (or that aren't numbers, when reading)
+// go through the stack, then the array part is tried again
+template<typename Number>
+static size_t ReadArrayElements( lua_State *state, int index, Number *values, size_t count, size_t offset )
+{
+	if( !lua_istable( state, index ) )
+		return 0;
+
+	index = AbsoluteIndex( state, index );
+	size_t read = 0;
+	while( true )
+	{
+		read += Internal::ReadArrayPart( state, index, values + read, count - read, offset + read );
+		if( read == count )
+			break;
+
+		lua_rawgeti( state, index, static_cast<ArrayIndex>( offset + read + 1 ) );
+		bool converted = ToArrayElement( state, values[read] );
+		lua_pop( state, 1 );
+		if( !converted )
+			break;
+
+		++read;
+	}
+
+	return read;
+}
+
+template<typename Number>
+static void WriteArrayElements( lua_State *state, int index, const Number *values, size_t count, size_t offset )
+{
+	luaL_checktype( state, index, LUA_TTABLE );
+	index = AbsoluteIndex( state, index );
+	size_t written = 0;
+	while( true )
+	{
+		written += Internal::WriteArrayPart( state, index, values + written, count - written, offset + written );
+		if( written == count )
+			break;
+
+		PushArrayElement( state, values[written] );
+		lua_rawseti( state, index, static_cast<ArrayIndex>( offset + written + 1 ) );
+		++written;
+	}
+}
+
+template<typename Number>
+static void PushArrayElements( Interface &lua, const Number *values, size_t count )
+{
+	if( count > static_cast<size_t>( INT_MAX ) )
+		lua.ThrowError( "array of %f elements is too big for a table", static_cast<double>( count ) );
+
+	lua_State *state = lua.GetLuaState( );
+	lua_createtable( state, static_cast<int>( count ), 0 );
+	WriteArrayElements( state, -1, values, count, 0 );
+}
+
+size_t Interface::ReadArray( int stackpos, double *values, size_t count, size_t offset )
+{
+	return ReadArrayElements( lua_state, stackpos, values, count, offset );
+}
+
+size_t Interface::ReadArray( int stackpos, long long *values, size_t count, size_t offset )
+{
+	return ReadArrayElements( lua_state, stackpos, values, count, offset );
+}
+
+void Interface::WriteArray( int stackpos, const double *values, size_t count, size_t offset )
+{
+	WriteArrayElements( lua_state, stackpos, values, count, offset );
+}
+
+void Interface::WriteArray( int stackpos, const long long *values, size_t count, size_t offset )
+{
+	WriteArrayElements( lua_state, stackpos, values, count, offset );
+}
+
+void Interface::PushArray( const double *values, size_t count )
+{
+	PushArrayElements( *this, values, count );
+}
+
+void Interface::PushArray( const long long *values, size_t count )
+{
+	PushArrayElements( *this, values, count );
 }
 
 void Interface::XMove( Interface &lua_interface, int n )
@@ -328,6 +831,29 @@ void *Interface::CheckUserdata( int stackpos, const char *name )
 	return luaL_checkudata( lua_state, stackpos, name );
 }
 
+void *Interface::CheckUserdata( int stackpos, const TypeTag &tag )
+{
+	void *userdata = TestUserdata( stackpos, tag );
+	if( userdata == nullptr )
+		TypeError( stackpos, tag.GetName( ) );
+
+	return userdata;
+}
+
+void *Interface::TestUserdata( int stackpos, const TypeTag &tag )
+{
+	void *userdata = lua_touserdata( lua_state, stackpos );
+	if( userdata == nullptr || lua_getmetatable( lua_state, stackpos ) == 0 )
+		return nullptr;
+
+	const void *metatable = lua_topointer( lua_state, -1 );
+	lua_pop( lua_state, 1 );
+
+	const std::vector<TypeEntry> &registered = GetMainInterface( ).types;
+	size_t id = tag.GetID( );
+	return id < registered.size( ) && registered[id].metatable == metatable ? userdata : nullptr;
+}
+
 void Interface::CheckAny( int stackpos )
 {
 	luaL_checkany( lua_state, stackpos );
@@ -353,69 +879,38 @@ int Interface::Equal( int stackpos_a, int stackpos_b )
 
 }
 
-int Interface::RawEqual( int stackpos_a, int stackpos_b )
-{
-	return lua_rawequal( lua_state, stackpos_a, stackpos_b );
-}
-
-void Interface::RawGet( int stackpos )
-{
-	lua_rawget( lua_state, stackpos );
-}
-
-void Interface::RawGetI( int stackpos, int n )
-{
-	lua_rawgeti( lua_state, stackpos, n );
-}
-
-void Interface::RawSet( int stackpos )
-{
-	lua_rawset( lua_state, stackpos );
-}
-
-void Interface::RawSetI( int stackpos, int n )
-{
-	lua_rawseti( lua_state, stackpos, n );
-}
-
 void Interface::Register( const char *libname, const ModuleFunction *list )
 {
 	luaL_register( lua_state, libname, reinterpret_cast<const luaL_Reg *>( list ) );
 }
 
-const char *Interface::ToString( int stackpos, size_t *outlen )
+lua_CFunction Interface::ToFunction( int stackpos )
 {
-	return lua_tolstring( lua_state, stackpos, outlen );
+	return lua_tocfunction( lua_state, stackpos );
 }
 
-const char *Interface::ToString( int stackpos )
+bool Interface::IsInteger( int stackpos )
 {
-	return lua_tostring( lua_state, stackpos );
-}
 
-double Interface::ToNumber( int stackpos )
-{
-	return lua_tonumber( lua_state, stackpos );
-}
+#if LUA_VERSION_NUM >= 503
 
-long long Interface::ToInteger( int stackpos )
-{
-	return lua_tointeger( lua_state, stackpos );
-}
+	int isnum = 0;
+	lua_tointegerx( lua_state, stackpos, &isnum );
+	return isnum != 0;
 
-bool Interface::ToBoolean( int stackpos )
-{
-	return lua_toboolean( lua_state, stackpos ) == 1;
-}
+#else
 
-lua_CFunction Interface::ToFunction( int stackpos )
-{
-	return lua_tocfunction( lua_state, stackpos );
-}
+	if( lua_isnumber( lua_state, stackpos ) == 0 )
+		return false;
+
+	// ToInteger casts to lua_Integer, which is only defined for values
+	// in its range
+	lua_Number number = lua_tonumber( lua_state, stackpos );
+	lua_Number limit = ldexp( 1.0, static_cast<int>( sizeof( lua_Integer ) * CHAR_BIT - 1 ) );
+	return number == floor( number ) && number >= -limit && number < limit;
+
+#endif
 
-void *Interface::ToUserdata( int stackpos )
-{
-	return lua_touserdata( lua_state, stackpos );
 }
 
 void *Interface::NewUserdata( size_t size )
@@ -423,6 +918,14 @@ void *Interface::NewUserdata( size_t size )
 	return lua_newuserdata( lua_state, size );
 }
 
+void *Interface::NewUserdata( size_t size, const TypeTag &tag )
+{
+	void *userdata = lua_newuserdata( lua_state, size );
+	GetMetaTable( tag );
+	lua_setmetatable( lua_state, -2 );
+	return userdata;
+}
+
 lua_State *Interface::NewThread( )
 {
 	return lua_newthread( lua_state );
@@ -517,26 +1020,6 @@ const char *Interface::GSub( const char *str, const char *pattern, const char *r
 	return luaL_gsub( lua_state, str, pattern, replacement );
 }
 
-void Interface::PushValue( int stackpos )
-{
-	lua_pushvalue( lua_state, stackpos );
-}
-
-void Interface::PushNil( )
-{
-	lua_pushnil( lua_state );
-}
-
-void Interface::PushString( const char *val, size_t len )
-{
-	lua_pushlstring( lua_state, val, len );
-}
-
-void Interface::PushString( const char *val )
-{
-	lua_pushstring( lua_state, val );
-}
-
 const char *Interface::PushFormattedString( const char *fmt, ... )
 {
 	va_list argp;
@@ -551,21 +1034,6 @@ const char *Interface::PushFormattedString( const char *fmt, va_list argp )
 	return lua_pushvfstring( lua_state, fmt, argp );
 }
 
-void Interface::PushNumber( double val )
-{
-	lua_pushnumber( lua_state, val );
-}
-
-void Interface::PushInteger( long long val )
-{
-	lua_pushinteger( lua_state, val );
-}
-
-void Interface::PushBoolean( bool val )
-{
-	lua_pushboolean( lua_state, val );
-}
-
 void Interface::PushFunction( Function val )
 {
 	lua_pushcfunction( lua_state, val );
@@ -576,11 +1044,6 @@ void Interface::PushClosure( Function val, int vars )
 	lua_pushcclosure( lua_state, val, vars );
 }
 
-void Interface::PushLightUserdata( void *val )
-{
-	lua_pushlightuserdata( lua_state, val );
-}
-
 int Interface::PushThread( lua_State *thread )
 {
 	return lua_pushthread( thread );
@@ -618,9 +1081,18 @@ int Interface::LoadString( const char *data )
 
 int Interface::LoadFile( const char *path )
 {
+	BytecodeCache *cache = GetMainInterface( ).bytecode_cache;
+	if( cache != nullptr && path != nullptr )
+		return cache->Load( *this, path );
+
 	return luaL_loadfile( lua_state, path );
 }
 
+void Interface::SetBytecodeCache( BytecodeCache *cache )
+{
+	GetMainInterface( ).bytecode_cache = cache;
+}
+
 int Interface::ReferenceCreate( )
 {
 	return luaL_ref( lua_state, LUA_REGISTRYINDEX );
@@ -646,14 +1118,54 @@ int Interface::GarbageCollect( GC what, int data )
 	return lua_gc( lua_state, static_cast<int>( what ), data );
 }
 
-Type Interface::GetType( int stackpos )
+static size_t GetMemoryInUse( lua_State *state )
 {
-	return static_cast<Type>( lua_type( lua_state, stackpos ) );
+	return static_cast<size_t>( lua_gc( state, LUA_GCCOUNT, 0 ) ) * 1024 + static_cast<size_t>( lua_gc( state, LUA_GCCOUNTB, 0 ) );
 }
 
-bool Interface::IsType( int stackpos, Type type )
+CollectResult Interface::CollectFor( std::chrono::microseconds budget )
 {
-	return GetType( stackpos ) == type;
+	typedef std::chrono::steady_clock clock;
+
+	clock::time_point start = clock::now( );
+	clock::time_point deadline = start + budget;
+	size_t memory = GetMemoryInUse( lua_state );
+
+	CollectResult result;
+	result.steps = 0;
+	result.cycle_finished = false;
+
+	// A step of size 0 is a single basic step of the collector, which
+	// keeps overruns short, and returns 1 when it finishes a cycle
+	clock::time_point now;
+	do
+	{
+		++result.steps;
+		result.cycle_finished = lua_gc( lua_state, LUA_GCSTEP, 0 ) != 0;
+		now = clock::now( );
+	}
+	while( !result.cycle_finished && now < deadline );
+
+	size_t remaining = GetMemoryInUse( lua_state );
+	result.bytes_freed = memory > remaining ? memory - remaining : 0;
+	result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>( now - start );
+	return result;
+}
+
+CollectResult Interface::CollectIdle( std::chrono::microseconds budget )
+{
+	if( Internal::IsCollectorPaused( lua_state ) &&
+		Internal::GetCollectorAllowance( lua_state ) > GetMemoryInUse( lua_state ) / 2 )
+	{
+		CollectResult result;
+		result.elapsed = std::chrono::microseconds::zero( );
+		result.steps = 0;
+		result.cycle_finished = false;
+		result.bytes_freed = 0;
+		return result;
+	}
+
+	return CollectFor( budget );
 }
 
 void Interface::CheckType( int stackpos, Type type )
@@ -668,7 +1180,196 @@ Object Interface::ToObject( int stackpos )
 
 void Interface::PushObject( const Object &obj )
 {
-	ReferencePush( obj.reference->Get( ) );
+	if( !obj.IsValid( ) || obj.reference == ReferenceNil )
+	{
+		lua_pushnil( lua_state );
+		return;
+	}
+
+	Interface &main = *obj.lua_interface;
+	if( main.reference_table == ReferenceInvalid )
+	{
+		lua_rawgeti( lua_state, LUA_REGISTRYINDEX, obj.reference );
+		return;
+	}
+
+	lua_rawgeti( lua_state, LUA_REGISTRYINDEX, main.reference_table );
+	lua_rawgeti( lua_state, -1, obj.reference );
+	lua_remove( lua_state, -2 );
+}
+
+void Interface::FlushReferences( )
+{
+	Interface &main = GetMainInterface( );
+	main.DrainForeignReleases( );
+
+	std::vector<int> &released = main.released_references;
+	if( released.empty( ) )
+		return;
+
+	if( main.reference_table == ReferenceInvalid )
+	{
+		for( size_t k = 0; k < released.size( ); ++k )
+			luaL_unref( lua_state, LUA_REGISTRYINDEX, released[k] );
+	}
+	else
+	{
+		lua_rawgeti( lua_state, LUA_REGISTRYINDEX, main.reference_table );
+		for( size_t k = 0; k < released.size( ); ++k )
+			luaL_unref( lua_state, -1, released[k] );
+
+		lua_pop( lua_state, 1 );
+	}
+
+	released.clear( );
+}
+
+bool Interface::SetReferenceTable( bool enable )
+{
+	Interface &main = GetMainInterface( );
+	if( main.object_count != 0 )
+		return false;
+
+	FlushReferences( );
+
+	if( enable && main.reference_table == ReferenceInvalid )
+	{
+		lua_newtable( lua_state );
+		main.reference_table = luaL_ref( lua_state, LUA_REGISTRYINDEX );
+	}
+	else if( !enable && main.reference_table != ReferenceInvalid )
+	{
+		luaL_unref( lua_state, LUA_REGISTRYINDEX, main.reference_table );
+		main.reference_table = ReferenceInvalid;
+	}
+
+	return true;
+}
+
+Interface &Interface::GetMainInterface( )
+{
+	return global_state == nullptr ? *this : ::GetLuaInterface( global_state );
+}
+
+int Interface::ObjectReferenceCreate( Interface &state )
+{
+	if( released_references.size( ) >= ReferenceReleaseBatch )
+		state.FlushReferences( );
+
+	int ref = ReferenceNil;
+	if( reference_table == ReferenceInvalid )
+	{
+		ref = luaL_ref( state.lua_state, LUA_REGISTRYINDEX );
+	}
+	else
+	{
+		lua_rawgeti( state.lua_state, LUA_REGISTRYINDEX, reference_table );
+		lua_insert( state.lua_state, -2 );
+		ref = luaL_ref( state.lua_state, -2 );
+		lua_pop( state.lua_state, 1 );
+	}
+
+	++object_count;
+	return ref;
+}
+
+void Interface::ObjectReferenceRelease( int ref )
+{
+	if( std::this_thread::get_id( ) != owner_thread.load( std::memory_order_relaxed ) )
+	{
+		ForeignRelease *node = new( std::nothrow ) ForeignRelease;
+		if( node == nullptr )
+		{
+			// Without memory for a node, wait for a free slot of the
+			// fixed size queue instead
+			std::unique_lock<std::mutex> lock( overflow_mutex );
+			while( overflow_count.load( std::memory_order_relaxed ) == ReferenceReleaseBatch )
+				overflow_drained.wait( lock );
+
+			size_t count = overflow_count.load( std::memory_order_relaxed );
+			overflow_references[count] = ref;
+			overflow_count.store( count + 1, std::memory_order_relaxed );
+			return;
+		}
+
+		node->reference = ref;
+		node->next = foreign_releases.load( std::memory_order_relaxed );
+		while( !foreign_releases.compare_exchange_weak( node->next, node, std::memory_order_release, std::memory_order_relaxed ) );
+		return;
+	}
+
+	--object_count;
+	QueueReference( ref );
+}
+
+void Interface::QueueReference( int ref )
+{
+	if( ref < 0 )
+		return;
+
+	try
+	{
+		released_references.push_back( ref );
+	}
+	catch( ... )
+	{
+		// Objects are released from destructors, which can't throw, so
+		// the reference is freed right away if it can't be queued
+		if( reference_table == ReferenceInvalid )
+		{
+			luaL_unref( lua_state, LUA_REGISTRYINDEX, ref );
+		}
+		else
+		{
+			lua_rawgeti( lua_state, LUA_REGISTRYINDEX, reference_table );
+			luaL_unref( lua_state, -1, ref );
+			lua_pop( lua_state, 1 );
+		}
+	}
+}
+
+void Interface::DrainForeignReleases( )
+{
+	ForeignRelease *node = foreign_releases.exchange( nullptr, std::memory_order_acquire );
+	while( node != nullptr )
+	{
+		--object_count;
+		QueueReference( node->reference );
+
+		ForeignRelease *next = node->next;
+		delete node;
+		node = next;
+	}
+
+	if( overflow_count.load( std::memory_order_relaxed ) != 0 )
+	{
+		std::lock_guard<std::mutex> lock( overflow_mutex );
+		size_t count = overflow_count.load( std::memory_order_relaxed );
+		for( size_t k = 0; k < count; ++k )
+		{
+			--object_count;
+			QueueReference( overflow_references[k] );
+		}
+
+		overflow_count.store( 0, std::memory_order_relaxed );
+		overflow_drained.notify_all( );
+	}
+}
+
+int Interface::ReleaseSentinelCollected( lua_State *state )
+{
+	// Runs once per garbage collection cycle: the sentinel is unreachable
+	// as soon as it's created and it's replaced every time it's collected
+	Interface &main = *static_cast<Interface *>( lua_touserdata( state, lua_upvalueindex( 1 ) ) );
+	main.DrainForeignReleases( );
+	main.metrics->CountCollection( );
+	CreateReleaseSentinel( state );
+	return 0;
+}
+
+void Interface::SetOwnerThread( )
+{
+	GetMainInterface( ).owner_thread.store( std::this_thread::get_id( ) );
 }
 
 int Interface::ThrowError( const char *fmt, ... )
@@ -680,32 +1381,423 @@ int Interface::ThrowError( const char *fmt, ... )
 	return Error( );
 }
 
-static int FunctionDumper( lua_State *state, const void *bchunk, size_t size, void *buffer )
+static int FunctionDumper( lua_State *, const void *bchunk, size_t size, void *builder )
+{
+	static_cast<StringBuilder *>( builder )->AddString( static_cast<const char *>( bchunk ), size );
+	return 0;
+}
+
+static int VectorDumper( lua_State *, const void *bchunk, size_t size, void *output )
 {
-	Buffer *lua_buffer = reinterpret_cast<Buffer *>( buffer );
-	const char *binary_chunk = reinterpret_cast<const char *>( bchunk );
-	GetLuaInterface( state ).BufferAddString( lua_buffer, binary_chunk, size );
+	const uint8_t *data = static_cast<const uint8_t *>( bchunk );
+	static_cast<std::vector<uint8_t> *>( output )->insert( static_cast<std::vector<uint8_t> *>( output )->end( ), data, data + size );
 	return 0;
 }
 
+static int FileDumper( lua_State *, const void *bchunk, size_t size, void *file )
+{
+	return fwrite( bchunk, 1, size, static_cast<FILE *>( file ) ) == size ? 0 : 1;
+}
+
 const char *Interface::Dump( size_t *outlen, bool strip )
 {
-	Buffer *buffer = BufferInit( );
+	StringBuilder builder( *this );
+	int status = Dump( FunctionDumper, &builder, strip );
+	const char *chunk = builder.Finish( outlen );
+	if( status != 0 )
+	{
+		Pop( 1 );
+		return nullptr;
+	}
+
+	return chunk;
+}
+
+int Interface::Dump( Writer writer, void *userdata, bool strip )
+{
 
 #if LUA_VERSION_NUM >= 503
 
-	if( lua_dump( lua_state, FunctionDumper, &buffer, strip ? 1 : 0 ) == 0 )
+	return lua_dump( lua_state, writer, userdata, strip ? 1 : 0 );
 
 #else
 
-	if( lua_dump( lua_state, FunctionDumper, &buffer ) == 0 )
+	static_cast<void>( strip );
+	return lua_dump( lua_state, writer, userdata );
 
 #endif
 
+}
+
+bool Interface::Dump( std::vector<uint8_t> &output, bool strip )
+{
+	// Writers must not raise errors, so allocation failures are caught here
+	try
+	{
+		return Dump( VectorDumper, &output, strip ) == 0;
+	}
+	catch( const std::bad_alloc & )
+	{
+		return false;
+	}
+}
+
+bool Interface::DumpFile( FILE *file, bool strip )
+{
+	return Dump( FileDumper, file, strip ) == 0;
+}
+
+static const TypeTag StringViewType( LUAINTERFACE_STRINGVIEW );
+
+static luainterface_stringview *CheckStringViewUserdata( lua_State *state, int stackpos )
+{
+	return static_cast<luainterface_stringview *>( GetLuaInterface( state ).CheckUserdata( stackpos, StringViewType ) );
+}
+
+// Released views (collected, or with __gc called by hand) are empty
+static const char *StringViewData( const luainterface_stringview *view )
+{
+	return view->data != nullptr ? view->data : "";
+}
+
+// Translates relative string positions like lstrlib.c
+static size_t StringViewPosition( lua_Integer position, size_t len )
+{
+	if( position >= 0 )
+		return static_cast<size_t>( position );
+	else if( static_cast<size_t>( -position ) > len )
+		return 0;
+
+	return len - static_cast<size_t>( -position ) + 1;
+}
+
+static int StringViewLength( lua_State *state )
+{
+	lua_pushinteger( state, static_cast<lua_Integer>( CheckStringViewUserdata( state, 1 )->len ) );
+	return 1;
+}
+
+static int StringViewToString( lua_State *state )
+{
+	luainterface_stringview *view = CheckStringViewUserdata( state, 1 );
+	lua_pushlstring( state, StringViewData( view ), view->len );
+	return 1;
+}
+
+static int StringViewSub( lua_State *state )
+{
+	luainterface_stringview *view = CheckStringViewUserdata( state, 1 );
+	size_t start = StringViewPosition( luaL_optinteger( state, 2, 1 ), view->len );
+	size_t end = StringViewPosition( luaL_optinteger( state, 3, -1 ), view->len );
+	if( start < 1 )
+		start = 1;
+
+	if( end > view->len )
+		end = view->len;
+
+	if( start <= end )
+		lua_pushlstring( state, StringViewData( view ) + start - 1, end - start + 1 );
+	else
+		lua_pushliteral( state, "" );
+
+	return 1;
+}
+
+static int StringViewByte( lua_State *state )
+{
+	luainterface_stringview *view = CheckStringViewUserdata( state, 1 );
+	lua_Integer first = luaL_optinteger( state, 2, 1 );
+	size_t start = StringViewPosition( first, view->len );
+	size_t end = StringViewPosition( luaL_optinteger( state, 3, first ), view->len );
+	if( start < 1 )
+		start = 1;
+
+	if( end > view->len )
+		end = view->len;
+
+	if( start > end )
+		return 0;
+
+	int count = static_cast<int>( end - start + 1 );
+	luaL_checkstack( state, count, "string slice too long" );
+	const char *data = StringViewData( view );
+	for( int k = 0; k < count; ++k )
+		lua_pushinteger( state, static_cast<uint8_t>( data[start + k - 1] ) );
+
+	return count;
+}
+
+static int StringViewConcat( lua_State *state )
+{
+	Interface &lua = GetLuaInterface( state );
+	size_t lena = 0, lenb = 0;
+	const char *a = lua.ToStringView( 1, &lena );
+	if( a == nullptr )
+		a = luaL_checklstring( state, 1, &lena );
+
+	const char *b = lua.ToStringView( 2, &lenb );
+	if( b == nullptr )
+		b = luaL_checklstring( state, 2, &lenb );
+
+	StringBuilder builder( lua );
+	builder.Reserve( lena + lenb );
+	builder.AddString( a, lena );
+	builder.AddString( b, lenb );
+	builder.Finish( );
+	return 1;
+}
+
+static int StringViewEqual( lua_State *state )
+{
+	luainterface_stringview *a = CheckStringViewUserdata( state, 1 );
+	luainterface_stringview *b = CheckStringViewUserdata( state, 2 );
+	lua_pushboolean( state, a->len == b->len && ( a->data == b->data || memcmp( StringViewData( a ), StringViewData( b ), a->len ) == 0 ) );
+	return 1;
+}
+
+static int StringViewCollect( lua_State *state )
+{
+	luainterface_stringview *view = CheckStringViewUserdata( state, 1 );
+	luainterface_stringview_release release = view->release;
+	const char *data = view->data;
+	size_t len = view->len;
+	view->release = nullptr;
+	view->data = nullptr;
+	view->len = 0;
+	if( release != nullptr )
+		release( data, len, view->userdata );
+
+	return 0;
+}
+
+static const luaL_Reg StringViewMetamethods[] = {
+	{ "__len", StringViewLength },
+	{ "__tostring", StringViewToString },
+	{ "__concat", StringViewConcat },
+	{ "__eq", StringViewEqual },
+	{ "__gc", StringViewCollect },
+	{ nullptr, nullptr }
+};
+
+// Kept apart from the metamethods, so Lua code can't call __gc
+static const luaL_Reg StringViewMethods[] = {
+	{ "len", StringViewLength },
+	{ "tostring", StringViewToString },
+	{ "sub", StringViewSub },
+	{ "byte", StringViewByte },
+	{ nullptr, nullptr }
+};
+
+void Interface::PushStringView( const char *data, size_t len, StringViewRelease release, void *userdata )
+{
+	try
+	{
+		luainterface_stringview *view = static_cast<luainterface_stringview *>( lua_newuserdata( lua_state, sizeof( luainterface_stringview ) ) );
+		view->data = data;
+		view->len = len;
+		view->release = nullptr;
+		view->userdata = userdata;
+
+		if( NewMetatable( StringViewType ) != 0 )
+		{
+			for( const luaL_Reg *method = StringViewMetamethods; method->name != nullptr; ++method )
+			{
+				lua_pushcfunction( lua_state, method->func );
+				lua_setfield( lua_state, -2, method->name );
+			}
+
+			lua_newtable( lua_state );
+			for( const luaL_Reg *method = StringViewMethods; method->name != nullptr; ++method )
+			{
+				lua_pushcfunction( lua_state, method->func );
+				lua_setfield( lua_state, -2, method->name );
+			}
+
+			lua_setfield( lua_state, -2, "__index" );
+
+			lua_pushboolean( lua_state, 0 );
+			lua_setfield( lua_state, -2, "__metatable" );
+		}
+
+		lua_setmetatable( lua_state, -2 );
+		view->release = release;
+	}
+	catch( ... )
+	{
+		if( release != nullptr )
+			release( data, len, userdata );
+
+		throw;
+	}
+}
+
+const char *Interface::ToStringView( int stackpos, size_t *outlen )
+{
+	if( lua_type( lua_state, stackpos ) == LUA_TSTRING )
+		return lua_tolstring( lua_state, stackpos, outlen );
+
+	luainterface_stringview *view = static_cast<luainterface_stringview *>( TestUserdata( stackpos, StringViewType ) );
+	if( view == nullptr )
 		return nullptr;
 
-	BufferFinish( buffer );
-	return ToString( -1, outlen );
+	if( outlen != nullptr )
+		*outlen = view->len;
+
+	return StringViewData( view );
+}
+
+const char *Interface::CheckStringView( int stackpos, size_t *outlen )
+{
+	const char *data = ToStringView( stackpos, outlen );
+	return data != nullptr ? data : luaL_checklstring( lua_state, stackpos, outlen );
+}
+
+void Interface::StartProfiler( unsigned int frequency )
+{
+	Interface &main = GetMainInterface( );
+	if( main.profiler == nullptr )
+		main.profiler = new Profiler( );
+
+	main.profiler->Start( lua_state, frequency );
+}
+
+void Interface::StopProfiler( )
+{
+	Interface &main = GetMainInterface( );
+	if( main.profiler != nullptr )
+		main.profiler->Stop( );
+}
+
+void Interface::ClearProfile( )
+{
+	Interface &main = GetMainInterface( );
+	if( main.profiler != nullptr )
+		main.profiler->Clear( );
+}
+
+bool Interface::DumpProfile( FILE *file )
+{
+	Interface &main = GetMainInterface( );
+	return main.profiler == nullptr || main.profiler->Dump( file );
+}
+
+void Interface::PushProfile( )
+{
+	Interface &main = GetMainInterface( );
+	if( main.profiler != nullptr )
+		main.profiler->Push( lua_state );
+	else
+		lua_newtable( lua_state );
+}
+
+// Reloads the C library of the module named by argument 1, like the C
+// searcher of require finds and opens it, and returns the new module
+static int ReloadModuleFunction( lua_State *state )
+{
+	const char *name = luaL_checkstring( state, 1 );
+	lua_getfield( state, LUA_REGISTRYINDEX, "_LOADED" );
+	lua_getfield( state, 2, name );
+	if( lua_isnil( state, 3 ) )
+		return luaL_error( state, "module '%s' isn't loaded", name );
+
+	lua_getfield( state, 2, LUA_LOADLIBNAME );
+	if( !lua_istable( state, 4 ) )
+		return luaL_error( state, "package library isn't loaded" );
+
+	lua_getfield( state, 4, "searchpath" );
+	lua_pushvalue( state, 1 );
+	lua_getfield( state, 4, "cpath" );
+	lua_call( state, 2, 2 );
+	if( lua_isnil( state, 5 ) )
+		return luaL_error( state, "module '%s' not found:%s", name, lua_tostring( state, 6 ) );
+
+	lua_settop( state, 5 );
+	const char *path = lua_tostring( state, 5 );
+	const char *mark = strchr( name, '-' );
+	const char *symbol = luaL_gsub( state, mark != nullptr ? mark + 1 : name, ".", "_" );
+	lua_pushfstring( state, "luaopen_%s", symbol );
+
+	// The old library stays loaded if the new one fails to open
+	lua_pushvalue( state, 1 );
+	lua_pushvalue( state, 5 );
+	if( luai_reloadlib( state, path, lua_tostring( state, 7 ), 2 ) != 0 )
+		return luaL_error( state, "error loading module '%s' from file '%s':\n\t%s", name, path, lua_tostring( state, -1 ) );
+
+	lua_replace( state, 7 );
+
+	// Like require, the module might have stored itself in package.loaded
+	if( !lua_isnil( state, 7 ) )
+	{
+		lua_pushvalue( state, 7 );
+		lua_setfield( state, 2, name );
+	}
+
+	lua_getfield( state, 2, name );
+	if( lua_isnil( state, -1 ) )
+	{
+		lua_pushboolean( state, 1 );
+		lua_replace( state, -2 );
+		lua_pushvalue( state, -1 );
+		lua_setfield( state, 2, name );
+	}
+
+	lua_replace( state, 7 );
+
+	// Modules registering themselves as globals (like luaL_register does)
+	Interface &lua = GetLuaInterface( state );
+	lua.PushGlobal( );
+	lua_getfield( state, -1, name );
+	if( lua_rawequal( state, -1, 3 ) )
+	{
+		lua_pushvalue( state, 7 );
+		lua_setfield( state, -3, name );
+	}
+
+	// loadlib falls back to the load function of the library when the
+	// symbol is missing, which isn't a migration function
+	lua_settop( state, 7 );
+	lua_getfield( state, 4, "loadlib" );
+	lua_pushvalue( state, 5 );
+	lua_pushstring( state, luai_moduleloadfunc );
+	lua_call( state, 2, 1 );
+	lua_CFunction fallback = lua_tocfunction( state, -1 );
+
+	lua_getfield( state, 4, "loadlib" );
+	lua_pushvalue( state, 5 );
+	lua_pushfstring( state, "luamigrate_%s", symbol );
+	lua_call( state, 2, 1 );
+	lua_CFunction migrate = lua_tocfunction( state, -1 );
+	if( migrate != nullptr && migrate != fallback )
+	{
+		lua_pushvalue( state, 3 );
+		lua_pushvalue( state, 7 );
+		lua_call( state, 2, 0 );
+	}
+
+	lua_settop( state, 7 );
+	return 1;
+}
+
+bool Interface::ReloadModule( const char *name )
+{
+	// Finalizers of the module's userdata can't run until its new
+	// version replaces the functions of the old one in their metatables
+	bool collecting = Internal::IsCollectorRunning( lua_state );
+	lua_gc( lua_state, LUA_GCSTOP, 0 );
+
+	lua_pushcfunction( lua_state, ReloadModuleFunction );
+	lua_pushstring( lua_state, name );
+	int status = lua_pcall( lua_state, 1, 1, 0 );
+
+	if( collecting )
+		lua_gc( lua_state, LUA_GCRESTART, 0 );
+
+	return status == 0;
+}
+
+Metrics Interface::GetMetrics( )
+{
+	return GetMainInterface( ).metrics->Snapshot( );
 }
 
 bool Interface::RunBuffer( const char *data, size_t size, const char *name, bool pcall )
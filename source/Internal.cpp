@@ -11,6 +11,7 @@
 extern "C"
 {
 	#include <lj_obj.h>
+	#include <lj_gc.h>
 }
 
 #define _STDINT
@@ -18,6 +19,7 @@ extern "C"
 #else
 
 #include <lstate.h>
+#include <lgc.h>
 
 #endif
 
@@ -50,6 +52,231 @@ void SetLuaInterface( lua_State *state, Interface *iface )
 	state->lua_interface = iface;
 }
 
+Interface *GetLuaInterface( lua_State *state )
+{
+	return static_cast<Interface *>( state->lua_interface );
+}
+
+lua_State *GetMainThread( lua_State *state )
+{
+
+#ifdef LUAJIT_VERSION
+
+	return mainthread( G( state ) );
+
+#else
+
+	return G( state )->mainthread;
+
+#endif
+
+}
+
+size_t GetStackSize( lua_State *state )
+{
+	return static_cast<size_t>( state->stacksize );
+}
+
+// Nested C calls of the thread (coroutines start from the depth of their
+// resumer), which grows while a collection runs finalizers
+unsigned int GetCallDepth( lua_State *state )
+{
+
+#ifdef LUAJIT_VERSION
+
+	// Not tracked, LuaJIT doesn't report collections either
+	static_cast<void>( state );
+	return 0;
+
+#else
+
+	return state->nCcalls;
+
+#endif
+
+}
+
+bool IsCollectorPaused( lua_State *state )
+{
+
+#ifdef LUAJIT_VERSION
+
+	return G( state )->gc.state == GCSpause;
+
+#else
+
+	return G( state )->gcstate == GCSpause;
+
+#endif
+
+}
+
+// Whether the collector wasn't stopped with lua_gc
+bool IsCollectorRunning( lua_State *state )
+{
+
+#ifdef LUAJIT_VERSION
+
+	return G( state )->gc.threshold != LJ_MAX_MEM;
+
+#else
+
+	return lua_gc( state, LUA_GCISRUNNING, 0 ) != 0;
+
+#endif
+
+}
+
+// Bytes that can be allocated before the collector runs by itself
+size_t GetCollectorAllowance( lua_State *state )
+{
+	global_State *g = G( state );
+
+#ifdef LUAJIT_VERSION
+
+	return g->gc.threshold > g->gc.total ? static_cast<size_t>( g->gc.threshold - g->gc.total ) : 0;
+
+#else
+
+	return g->GCdebt < 0 ? static_cast<size_t>( -g->GCdebt ) : 0;
+
+#endif
+
+}
+
+// The ArrayPart functions access the array part of the table at index
+// directly, handling the elements from offset up to the first one that
+// isn't in the array part or, when reading, isn't a number of the
+// requested kind. They return the number of elements handled.
+// Numbers aren't collectable, so writes need no GC barrier.
+
+#ifdef LUAJIT_VERSION
+
+// Element 0 of the array part holds t[0]
+static TValue *GetArrayPart( lua_State *state, int index, size_t offset, size_t &available )
+{
+	GCtab *table = static_cast<GCtab *>( const_cast<void *>( lua_topointer( state, index ) ) );
+	size_t size = table->asize;
+	available = size > offset + 1 ? size - offset - 1 : 0;
+	return tvref( table->array ) + offset + 1;
+}
+
+size_t ReadArrayPart( lua_State *state, int index, double *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	const TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		if( tvisnum( &array[k] ) )
+			values[k] = numV( &array[k] );
+		else if( tvisint( &array[k] ) )
+			values[k] = static_cast<double>( intV( &array[k] ) );
+		else
+			break;
+
+	return k;
+}
+
+size_t ReadArrayPart( lua_State *state, int index, long long *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	const TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		if( tvisint( &array[k] ) )
+			values[k] = intV( &array[k] );
+		else if( tvisnum( &array[k] ) )
+			values[k] = static_cast<long long>( numV( &array[k] ) );
+		else
+			break;
+
+	return k;
+}
+
+size_t WriteArrayPart( lua_State *state, int index, const double *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		setnumV( &array[k], values[k] );
+
+	return k;
+}
+
+size_t WriteArrayPart( lua_State *state, int index, const long long *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		setint64V( &array[k], values[k] );
+
+	return k;
+}
+
+#else
+
+static TValue *GetArrayPart( lua_State *state, int index, size_t offset, size_t &available )
+{
+	Table *table = static_cast<Table *>( const_cast<void *>( lua_topointer( state, index ) ) );
+	size_t size = table->sizearray;
+	available = size > offset ? size - offset : 0;
+	return table->array + offset;
+}
+
+size_t ReadArrayPart( lua_State *state, int index, double *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	const TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		if( ttisfloat( &array[k] ) )
+			values[k] = fltvalue( &array[k] );
+		else if( ttisinteger( &array[k] ) )
+			values[k] = static_cast<double>( ivalue( &array[k] ) );
+		else
+			break;
+
+	return k;
+}
+
+// Floats are left to lua_tointegerx, which only accepts integral values
+size_t ReadArrayPart( lua_State *state, int index, long long *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	const TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available && ttisinteger( &array[k] ); ++k )
+		values[k] = ivalue( &array[k] );
+
+	return k;
+}
+
+size_t WriteArrayPart( lua_State *state, int index, const double *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		setfltvalue( &array[k], values[k] );
+
+	return k;
+}
+
+size_t WriteArrayPart( lua_State *state, int index, const long long *values, size_t count, size_t offset )
+{
+	size_t available = 0;
+	TValue *array = GetArrayPart( state, index, offset, available );
+	size_t k = 0;
+	for( ; k < count && k < available; ++k )
+		setivalue( &array[k], values[k] );
+
+	return k;
+}
+
+#endif
+
 }
 
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 namespace Lua
 {
 
@@ -10,6 +12,28 @@ namespace Internal
 
 void SetLuaInterface( struct lua_State *state, Interface *iface );
 
+Interface *GetLuaInterface( struct lua_State *state );
+
+struct lua_State *GetMainThread( struct lua_State *state );
+
+size_t GetStackSize( struct lua_State *state );
+
+unsigned int GetCallDepth( struct lua_State *state );
+
+bool IsCollectorPaused( struct lua_State *state );
+
+bool IsCollectorRunning( struct lua_State *state );
+
+size_t GetCollectorAllowance( struct lua_State *state );
+
+size_t ReadArrayPart( struct lua_State *state, int index, double *values, size_t count, size_t offset );
+
+size_t ReadArrayPart( struct lua_State *state, int index, long long *values, size_t count, size_t offset );
+
+size_t WriteArrayPart( struct lua_State *state, int index, const double *values, size_t count, size_t offset );
+
+size_t WriteArrayPart( struct lua_State *state, int index, const long long *values, size_t count, size_t offset );
+
 }
 
 }
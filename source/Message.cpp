@@ -0,0 +1,543 @@
+#include <lua.hpp>
+#include <Lua/Message.hpp>
+#include <Lua/Interface.hpp>
+#include <Lua/StringView.h>
+#include <string.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace Lua
+{
+
+enum MessageTag
+{
+	TagNil,
+	TagFalse,
+	TagTrue,
+	TagInteger,
+	TagNumber,
+	TagString,
+	TagTable,
+	TagReference,
+	TagLightUserdata,
+	TagUserdata
+};
+
+// Deeper tables would overflow the C stack
+static const int MaxDepth = 200;
+
+struct MessageType
+{
+	const TypeTag *tag;
+	Message::Encoder encoder;
+	Message::Decoder decoder;
+};
+
+static std::mutex types_mutex;
+
+static std::vector<MessageType> &GetTypes( )
+{
+	static std::vector<MessageType> types;
+	return types;
+}
+
+// Strings, tables and userdata are numbered in the order they're
+// first encoded, which is the order they're decoded in, and later
+// occurrences refer to them by number
+class MessageEncoder
+{
+public:
+	MessageEncoder( Interface &lua, std::vector<uint8_t> &buffer ) :
+		lua( lua ),
+		state( lua.GetLuaState( ) ),
+		buffer( buffer ),
+		reference_count( 0 )
+	{ }
+
+	bool Write( int index, int depth )
+	{
+		switch( lua_type( state, index ) )
+		{
+			case LUA_TNIL:
+				WriteByte( TagNil );
+				return true;
+
+			case LUA_TBOOLEAN:
+				WriteByte( lua_toboolean( state, index ) != 0 ? TagTrue : TagFalse );
+				return true;
+
+			case LUA_TNUMBER:
+				WriteNumber( index );
+				return true;
+
+			case LUA_TSTRING:
+			{
+				size_t len = 0;
+				const char *data = lua_tolstring( state, index, &len );
+				if( !WriteReference( data ) )
+					WriteString( data, len );
+
+				return true;
+			}
+
+			case LUA_TTABLE:
+				return WriteTable( index, depth );
+
+			case LUA_TLIGHTUSERDATA:
+			{
+				void *pointer = lua_touserdata( state, index );
+				WriteByte( TagLightUserdata );
+				WriteBytes( &pointer, sizeof( pointer ) );
+				return true;
+			}
+
+			case LUA_TUSERDATA:
+				return WriteUserdata( index );
+
+			default:
+				return false;
+		}
+	}
+
+private:
+	void WriteByte( uint8_t byte )
+	{
+		buffer.push_back( byte );
+	}
+
+	void WriteBytes( const void *data, size_t size )
+	{
+		const uint8_t *bytes = static_cast<const uint8_t *>( data );
+		buffer.insert( buffer.end( ), bytes, bytes + size );
+	}
+
+	void WriteVarint( uint64_t value )
+	{
+		while( value >= 0x80 )
+		{
+			buffer.push_back( static_cast<uint8_t>( value | 0x80 ) );
+			value >>= 7;
+		}
+
+		buffer.push_back( static_cast<uint8_t>( value ) );
+	}
+
+	// Fixed size, so it can be patched once known
+	void PatchSize( size_t position, uint32_t value )
+	{
+		memcpy( &buffer[position], &value, sizeof( value ) );
+	}
+
+	void WriteNumber( int index )
+	{
+
+#if LUA_VERSION_NUM >= 503
+
+		if( lua_isinteger( state, index ) )
+		{
+			// Zigzag encoding keeps small negative integers short
+			uint64_t value = static_cast<uint64_t>( lua_tointeger( state, index ) );
+			WriteByte( TagInteger );
+			WriteVarint( ( value << 1 ) ^ ( 0 - ( value >> 63 ) ) );
+			return;
+		}
+
+#endif
+
+		lua_Number number = lua_tonumber( state, index );
+		WriteByte( TagNumber );
+		WriteBytes( &number, sizeof( number ) );
+	}
+
+	void WriteString( const char *data, size_t len )
+	{
+		WriteByte( TagString );
+		WriteVarint( len );
+		WriteBytes( data, len );
+	}
+
+	// Writes a reference if the object was encoded already, numbers it otherwise
+	bool WriteReference( const void *pointer )
+	{
+		std::pair<std::unordered_map<const void *, uint64_t>::iterator, bool> inserted =
+			references.insert( std::make_pair( pointer, reference_count ) );
+		if( inserted.second )
+		{
+			++reference_count;
+			return false;
+		}
+
+		WriteByte( TagReference );
+		WriteVarint( inserted.first->second );
+		return true;
+	}
+
+	bool WriteTable( int index, int depth )
+	{
+		if( WriteReference( lua_topointer( state, index ) ) )
+			return true;
+
+		if( depth >= MaxDepth || lua_checkstack( state, 3 ) == 0 )
+			return false;
+
+		WriteByte( TagTable );
+		size_t sizes = buffer.size( );
+		buffer.resize( sizes + 2 * sizeof( uint32_t ) );
+
+		uint32_t array_count = 0, hash_count = 0;
+		lua_pushnil( state );
+		while( lua_next( state, index ) != 0 )
+		{
+			int top = lua_gettop( state );
+			if( !Write( top - 1, depth + 1 ) || !Write( top, depth + 1 ) )
+			{
+				lua_pop( state, 2 );
+				return false;
+			}
+
+			if( IsArrayKey( top - 1 ) )
+				++array_count;
+			else
+				++hash_count;
+
+			lua_pop( state, 1 );
+		}
+
+		PatchSize( sizes, array_count );
+		PatchSize( sizes + sizeof( uint32_t ), hash_count );
+		return true;
+	}
+
+	// Only a hint to size the decoded table
+	bool IsArrayKey( int index )
+	{
+		if( lua_type( state, index ) != LUA_TNUMBER )
+			return false;
+
+		// Converting doubles out of the range of int64_t is undefined
+		lua_Number key = lua_tonumber( state, index );
+		return key >= 1 && key < 9223372036854775808.0 && key == static_cast<lua_Number>( static_cast<int64_t>( key ) );
+	}
+
+	bool WriteUserdata( int index )
+	{
+		size_t len = 0;
+		const char *data = luainterface_tostringview( state, index, &len );
+		if( data != nullptr )
+		{
+			if( !WriteReference( lua_topointer( state, index ) ) )
+				WriteString( data, len );
+
+			return true;
+		}
+
+		MessageType type;
+		if( !FindType( index, type ) )
+			return false;
+
+		if( WriteReference( lua_topointer( state, index ) ) )
+			return true;
+
+		WriteByte( TagUserdata );
+		WriteVarint( type.tag->GetID( ) );
+		size_t size = buffer.size( );
+		buffer.resize( size + sizeof( uint32_t ) );
+		type.encoder( lua, index, buffer );
+		PatchSize( size, static_cast<uint32_t>( buffer.size( ) - size - sizeof( uint32_t ) ) );
+		return true;
+	}
+
+	bool FindType( int index, MessageType &type )
+	{
+		std::lock_guard<std::mutex> lock( types_mutex );
+		const std::vector<MessageType> &types = GetTypes( );
+		for( size_t k = 0; k < types.size( ); ++k )
+			if( lua.TestUserdata( index, *types[k].tag ) != nullptr )
+			{
+				type = types[k];
+				return true;
+			}
+
+		return false;
+	}
+
+	Interface &lua;
+	lua_State *state;
+	std::vector<uint8_t> &buffer;
+	std::unordered_map<const void *, uint64_t> references;
+	uint64_t reference_count;
+};
+
+// Decoded strings, tables and userdata are kept in the array of the
+// references table, so later references can push them again
+class MessageDecoder
+{
+public:
+	MessageDecoder( Interface &lua, const uint8_t *data, size_t size, int references ) :
+		lua( lua ),
+		state( lua.GetLuaState( ) ),
+		data( data ),
+		end( data + size ),
+		references( references ),
+		reference_count( 0 )
+	{ }
+
+	bool Read( int depth )
+	{
+		if( data == end || lua_checkstack( state, 3 ) == 0 )
+			return false;
+
+		switch( *data++ )
+		{
+			case TagNil:
+				lua_pushnil( state );
+				return true;
+
+			case TagFalse:
+				lua_pushboolean( state, 0 );
+				return true;
+
+			case TagTrue:
+				lua_pushboolean( state, 1 );
+				return true;
+
+			case TagInteger:
+			{
+				uint64_t value = 0;
+				if( !ReadVarint( value ) )
+					return false;
+
+				lua_pushinteger( state, static_cast<lua_Integer>( static_cast<int64_t>( ( value >> 1 ) ^ ( 0 - ( value & 1 ) ) ) ) );
+				return true;
+			}
+
+			case TagNumber:
+			{
+				lua_Number number = 0;
+				if( !ReadBytes( &number, sizeof( number ) ) )
+					return false;
+
+				lua_pushnumber( state, number );
+				return true;
+			}
+
+			case TagString:
+			{
+				uint64_t len = 0;
+				if( !ReadVarint( len ) || static_cast<uint64_t>( end - data ) < len )
+					return false;
+
+				lua_pushlstring( state, reinterpret_cast<const char *>( data ), static_cast<size_t>( len ) );
+				data += len;
+				AddReference( );
+				return true;
+			}
+
+			case TagTable:
+				return ReadTable( depth );
+
+			case TagReference:
+			{
+				uint64_t reference = 0;
+				if( !ReadVarint( reference ) || reference >= reference_count )
+					return false;
+
+				lua_rawgeti( state, references, static_cast<int>( reference + 1 ) );
+				return true;
+			}
+
+			case TagLightUserdata:
+			{
+				void *pointer = nullptr;
+				if( !ReadBytes( &pointer, sizeof( pointer ) ) )
+					return false;
+
+				lua_pushlightuserdata( state, pointer );
+				return true;
+			}
+
+			case TagUserdata:
+				return ReadUserdata( );
+
+			default:
+				return false;
+		}
+	}
+
+private:
+	bool ReadBytes( void *output, size_t size )
+	{
+		if( static_cast<size_t>( end - data ) < size )
+			return false;
+
+		memcpy( output, data, size );
+		data += size;
+		return true;
+	}
+
+	bool ReadVarint( uint64_t &value )
+	{
+		value = 0;
+		for( int shift = 0; data != end && shift < 64; shift += 7 )
+		{
+			uint8_t byte = *data++;
+			value |= static_cast<uint64_t>( byte & 0x7F ) << shift;
+			if( ( byte & 0x80 ) == 0 )
+				return true;
+		}
+
+		return false;
+	}
+
+	void AddReference( )
+	{
+		lua_pushvalue( state, -1 );
+		lua_rawseti( state, references, static_cast<int>( ++reference_count ) );
+	}
+
+	// Limited to the same depth as WriteTable
+	bool ReadTable( int depth )
+	{
+		if( depth >= MaxDepth )
+			return false;
+
+		uint32_t array_count = 0, hash_count = 0;
+		if( !ReadBytes( &array_count, sizeof( array_count ) ) || !ReadBytes( &hash_count, sizeof( hash_count ) ) )
+			return false;
+
+		// Every pair takes 2 bytes at least
+		uint64_t count = static_cast<uint64_t>( array_count ) + hash_count;
+		if( count > static_cast<uint64_t>( end - data ) / 2 )
+			return false;
+
+		lua_createtable( state, static_cast<int>( array_count ), static_cast<int>( hash_count ) );
+		AddReference( );
+		for( uint64_t k = 0; k < count; ++k )
+		{
+			if( !Read( depth + 1 ) )
+				return false;
+
+			if( !Read( depth + 1 ) )
+			{
+				lua_pop( state, 1 );
+				return false;
+			}
+
+			if( lua_isnil( state, -2 ) )
+			{
+				lua_pop( state, 2 );
+				return false;
+			}
+
+			lua_rawset( state, -3 );
+		}
+
+		return true;
+	}
+
+	bool ReadUserdata( )
+	{
+		uint64_t id = 0;
+		uint32_t size = 0;
+		if( !ReadVarint( id ) || !ReadBytes( &size, sizeof( size ) ) || static_cast<size_t>( end - data ) < size )
+			return false;
+
+		Message::Decoder decoder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock( types_mutex );
+			const std::vector<MessageType> &types = GetTypes( );
+			for( size_t k = 0; k < types.size( ) && decoder == nullptr; ++k )
+				if( types[k].tag->GetID( ) == id )
+					decoder = types[k].decoder;
+		}
+
+		if( decoder == nullptr )
+			return false;
+
+		int top = lua_gettop( state );
+		decoder( lua, data, size );
+		data += size;
+		if( lua_gettop( state ) != top + 1 )
+		{
+			lua_settop( state, top );
+			return false;
+		}
+
+		AddReference( );
+		return true;
+	}
+
+	Interface &lua;
+	lua_State *state;
+	const uint8_t *data;
+	const uint8_t *end;
+	int references;
+	uint64_t reference_count;
+};
+
+Message::Message( )
+{ }
+
+Message::Message( const void *data, size_t size ) :
+	buffer( static_cast<const uint8_t *>( data ), static_cast<const uint8_t *>( data ) + size )
+{ }
+
+bool Message::Encode( Interface &lua, int stackpos )
+{
+	lua_State *state = lua.GetLuaState( );
+	if( stackpos < 0 && -stackpos <= lua_gettop( state ) )
+		stackpos = lua_gettop( state ) + stackpos + 1;
+
+	buffer.clear( );
+	int top = lua_gettop( state );
+	MessageEncoder encoder( lua, buffer );
+	if( encoder.Write( stackpos, 0 ) )
+		return true;
+
+	lua_settop( state, top );
+	buffer.clear( );
+	return false;
+}
+
+bool Message::Decode( Interface &lua ) const
+{
+	if( buffer.empty( ) )
+		return false;
+
+	lua_State *state = lua.GetLuaState( );
+	int top = lua_gettop( state );
+	lua_newtable( state );
+	MessageDecoder decoder( lua, buffer.data( ), buffer.size( ), top + 1 );
+	if( !decoder.Read( 0 ) )
+	{
+		lua_settop( state, top );
+		return false;
+	}
+
+	lua_remove( state, top + 1 );
+	return true;
+}
+
+bool Message::IsEmpty( ) const
+{
+	return buffer.empty( );
+}
+
+const uint8_t *Message::GetData( ) const
+{
+	return buffer.data( );
+}
+
+size_t Message::GetSize( ) const
+{
+	return buffer.size( );
+}
+
+void Message::RegisterType( const TypeTag &tag, Encoder encoder, Decoder decoder )
+{
+	MessageType type = { &tag, encoder, decoder };
+	std::lock_guard<std::mutex> lock( types_mutex );
+	GetTypes( ).push_back( type );
+}
+
+}
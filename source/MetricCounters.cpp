@@ -0,0 +1,116 @@
+#include <lua.hpp>
+#include <MetricCounters.hpp>
+#include <Internal.hpp>
+
+namespace Lua
+{
+
+// Every counter has a single writer, the thread running the Lua state,
+// so they're updated with plain loads and stores instead of atomic
+// read-modify-write operations, and readers on other threads never lock
+static void Add( std::atomic<uint64_t> &counter, uint64_t value )
+{
+	counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+}
+
+MetricCounters::MetricCounters( lua_State *state ) :
+	collector_depth( 0 ),
+	collector_calls( 0 ),
+	bytes_allocated( 0 ),
+	bytes_freed( 0 ),
+	gc_cycles( 0 ),
+	gc_time( 0 ),
+	pcalls( 0 ),
+	errors( 0 ),
+	peak_stack( 0 )
+{
+	// Interposes on the allocator of the state, whichever it is
+	allocator = lua_getallocf( state, &allocator_userdata );
+	lua_setallocf( state, Allocate, this );
+}
+
+Metrics MetricCounters::Snapshot( ) const
+{
+	Metrics metrics;
+	metrics.bytes_allocated = bytes_allocated.load( std::memory_order_relaxed );
+	metrics.bytes_freed = bytes_freed.load( std::memory_order_relaxed );
+	metrics.gc_cycles = gc_cycles.load( std::memory_order_relaxed );
+	metrics.gc_time = gc_time.load( std::memory_order_relaxed );
+	metrics.pcalls = pcalls.load( std::memory_order_relaxed );
+	metrics.errors = errors.load( std::memory_order_relaxed );
+	metrics.peak_stack = peak_stack.load( std::memory_order_relaxed );
+	return metrics;
+}
+
+void MetricCounters::CountCall( lua_State *state, int status )
+{
+	Add( pcalls, 1 );
+	if( status != 0 )
+		Add( errors, 1 );
+
+	uint64_t stack = Internal::GetStackSize( state );
+	if( stack > peak_stack.load( std::memory_order_relaxed ) )
+		peak_stack.store( stack, std::memory_order_relaxed );
+}
+
+void MetricCounters::CountCollection( )
+{
+	Add( gc_cycles, 1 );
+}
+
+// Collections started by finalizers run within the outermost one, which
+// is the only one timed
+void MetricCounters::CollectorStarted( lua_State *state )
+{
+	MetricCounters *counters = Get( state );
+	if( counters == nullptr )
+		return;
+
+	// A collection interrupted by an error (raised by a finalizer) never
+	// finishes, and the next one starts from no deeper C calls than it
+	unsigned int calls = Internal::GetCallDepth( state );
+	if( counters->collector_depth != 0 && calls <= counters->collector_calls )
+		counters->collector_depth = 0;
+
+	if( counters->collector_depth++ == 0 )
+	{
+		counters->collector_started = std::chrono::steady_clock::now( );
+		counters->collector_calls = calls;
+	}
+}
+
+void MetricCounters::CollectorFinished( lua_State *state )
+{
+	MetricCounters *counters = Get( state );
+	if( counters == nullptr || counters->collector_depth == 0 || --counters->collector_depth != 0 )
+		return;
+
+	std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now( ) - counters->collector_started;
+	Add( counters->gc_time, static_cast<uint64_t>( elapsed.count( ) ) );
+}
+
+void *MetricCounters::Allocate( void *userdata, void *ptr, size_t oldsize, size_t newsize )
+{
+	MetricCounters *counters = static_cast<MetricCounters *>( userdata );
+	void *block = counters->allocator( counters->allocator_userdata, ptr, oldsize, newsize );
+	if( block == nullptr && newsize != 0 )
+		return nullptr;
+
+	// When ptr is null, oldsize is the type of the object being created
+	if( ptr != nullptr )
+		Add( counters->bytes_freed, oldsize );
+
+	Add( counters->bytes_allocated, newsize );
+	return block;
+}
+
+MetricCounters *MetricCounters::Get( lua_State *state )
+{
+	void *userdata = nullptr;
+	if( lua_getallocf( state, &userdata ) != Allocate )
+		return nullptr;
+
+	return static_cast<MetricCounters *>( userdata );
+}
+
+}
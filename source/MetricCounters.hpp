@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Lua/Metrics.hpp>
+#include <atomic>
+#include <chrono>
+
+namespace Lua
+{
+
+class MetricCounters
+{
+public:
+	MetricCounters( lua_State *state );
+
+	Metrics Snapshot( ) const;
+
+	void CountCall( lua_State *state, int status );
+	void CountCollection( );
+
+	static void CollectorStarted( lua_State *state );
+	static void CollectorFinished( lua_State *state );
+
+private:
+	MetricCounters( const MetricCounters & );
+	MetricCounters &operator=( const MetricCounters & );
+
+	static void *Allocate( void *userdata, void *ptr, size_t oldsize, size_t newsize );
+	static MetricCounters *Get( lua_State *state );
+
+	typedef void *( *Allocator )( void *userdata, void *ptr, size_t oldsize, size_t newsize );
+
+	Allocator allocator;
+	void *allocator_userdata;
+	std::chrono::steady_clock::time_point collector_started;
+	unsigned int collector_depth;
+	unsigned int collector_calls;
+
+	std::atomic<uint64_t> bytes_allocated;
+	std::atomic<uint64_t> bytes_freed;
+	std::atomic<uint64_t> gc_cycles;
+	std::atomic<uint64_t> gc_time;
+	std::atomic<uint64_t> pcalls;
+	std::atomic<uint64_t> errors;
+	std::atomic<uint64_t> peak_stack;
+};
+
+}
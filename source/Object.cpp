@@ -1,15 +1,89 @@
 #include <Lua/Object.hpp>
 #include <Lua/Interface.hpp>
-#include <Reference.hpp>
-#include <atomic>
 
 namespace Lua
 {
 
-Object::Object( Interface *state, int index )
+Object::Object( ) :
+	lua_interface( nullptr ),
+	reference( ReferenceInvalid )
+{ }
+
+Object::Object( Interface *state, int index ) :
+	lua_interface( &state->GetMainInterface( ) ),
+	reference( ReferenceInvalid )
 {
 	state->PushValue( index );
-	reference = std::make_shared<Reference>( state );
+	reference = lua_interface->ObjectReferenceCreate( *state );
+}
+
+Object::Object( const Object &obj ) :
+	lua_interface( obj.lua_interface ),
+	reference( ReferenceInvalid )
+{
+	if( obj.IsValid( ) )
+	{
+		lua_interface->PushObject( obj );
+		reference = lua_interface->ObjectReferenceCreate( *lua_interface );
+	}
+}
+
+Object::Object( Object &&obj ) :
+	lua_interface( obj.lua_interface ),
+	reference( obj.reference )
+{
+	obj.lua_interface = nullptr;
+	obj.reference = ReferenceInvalid;
+}
+
+Object::~Object( )
+{
+	Release( );
+}
+
+Object &Object::operator=( const Object &obj )
+{
+	if( this != &obj )
+	{
+		Object copy( obj );
+		*this = static_cast<Object &&>( copy );
+	}
+
+	return *this;
+}
+
+Object &Object::operator=( Object &&obj )
+{
+	if( this != &obj )
+	{
+		Release( );
+		lua_interface = obj.lua_interface;
+		reference = obj.reference;
+		obj.lua_interface = nullptr;
+		obj.reference = ReferenceInvalid;
+	}
+
+	return *this;
+}
+
+bool Object::IsValid( ) const
+{
+	return lua_interface != nullptr && reference != ReferenceInvalid;
+}
+
+Interface *Object::GetLuaInterface( ) const
+{
+	return lua_interface;
+}
+
+void Object::Release( )
+{
+	if( lua_interface != nullptr )
+	{
+		lua_interface->ObjectReferenceRelease( reference );
+		lua_interface = nullptr;
+		reference = ReferenceInvalid;
+	}
 }
 
 }
@@ -0,0 +1,359 @@
+#include <lua.hpp>
+#include <Profiler.hpp>
+#include <Internal.hpp>
+#include <Lua/Interface.hpp>
+#include <string.h>
+
+#if defined _WIN32
+
+#define snprintf _snprintf
+
+#elif defined __linux__
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if !defined sigev_notify_thread_id
+
+#define sigev_notify_thread_id _sigev_un._tid
+
+#endif
+
+#endif
+
+namespace Lua
+{
+
+static const int MaxStackDepth = 128;
+
+#if defined __linux__
+
+// Profilers sampling with timer signals, found by the signal handler
+// through the slot sent with the signal (a signal still pending after the
+// profiler stops finds its slot empty)
+static const int MaxSignalSlots = 64;
+static std::atomic<Profiler *> signal_profilers[MaxSignalSlots];
+static std::mutex signal_mutex;
+static bool signal_installed = false;
+static struct sigaction signal_previous;
+
+#endif
+
+Profiler::Profiler( ) :
+	main_state( nullptr ),
+	running( false ),
+	previous_hook( nullptr ),
+	previous_mask( 0 ),
+	previous_count( 0 ),
+	interval( 1000 )
+
+#if defined __linux__
+
+	, signal_slot( -1 )
+
+#endif
+
+{ }
+
+Profiler::~Profiler( )
+{
+
+#if defined __linux__
+
+	if( signal_slot >= 0 )
+		StopSignal( );
+
+#endif
+
+	if( timer.joinable( ) )
+	{
+		{
+			std::lock_guard<std::mutex> lock( timer_mutex );
+			running = false;
+		}
+
+		timer_stopped.notify_all( );
+		timer.join( );
+	}
+
+	if( main_state != nullptr )
+		Disarm( main_state );
+}
+
+void Profiler::Start( lua_State *state, unsigned int frequency )
+{
+	if( running )
+		return;
+
+	interval = std::chrono::microseconds( 1000000 / ( frequency != 0 ? frequency : 1 ) );
+	main_state = Internal::GetMainThread( state );
+	running = true;
+
+#if defined __linux__
+
+	if( StartSignal( ) )
+		return;
+
+#endif
+
+	timer = std::thread( &Profiler::Tick, this );
+}
+
+void Profiler::Stop( )
+{
+	if( !running )
+		return;
+
+#if defined __linux__
+
+	if( signal_slot >= 0 )
+	{
+		running = false;
+		StopSignal( );
+		Disarm( main_state );
+		return;
+	}
+
+#endif
+
+	{
+		std::lock_guard<std::mutex> lock( timer_mutex );
+		running = false;
+	}
+
+	timer_stopped.notify_all( );
+	timer.join( );
+
+	// The timer might have armed the hook right before stopping
+	Disarm( main_state );
+}
+
+void Profiler::Clear( )
+{
+	stacks.clear( );
+}
+
+bool Profiler::Dump( FILE *file ) const
+{
+	for( std::unordered_map<std::string, size_t>::const_iterator it = stacks.begin( ); it != stacks.end( ); ++it )
+		if( fprintf( file, "%s %llu\n", it->first.c_str( ), static_cast<unsigned long long>( it->second ) ) < 0 )
+			return false;
+
+	return true;
+}
+
+void Profiler::Push( lua_State *state ) const
+{
+	lua_createtable( state, 0, static_cast<int>( stacks.size( ) ) );
+	for( std::unordered_map<std::string, size_t>::const_iterator it = stacks.begin( ); it != stacks.end( ); ++it )
+	{
+		lua_pushlstring( state, it->first.data( ), it->first.size( ) );
+		lua_pushnumber( state, static_cast<lua_Number>( it->second ) );
+		lua_rawset( state, -3 );
+	}
+}
+
+void Profiler::Hook( lua_State *state, lua_Debug * )
+{
+	Interface *lua = Internal::GetLuaInterface( Internal::GetMainThread( state ) );
+	Profiler *profiler = lua != nullptr ? lua->profiler : nullptr;
+	if( profiler == nullptr )
+	{
+		lua_sethook( state, nullptr, 0, 0 );
+		return;
+	}
+
+	// Armed by the timer for a single sample
+	profiler->Disarm( state );
+	if( profiler->running )
+		profiler->Sample( state );
+}
+
+// Replaces the hook of the state (like one set with debug.sethook) for a
+// single instruction, keeping it to be put back by Disarm
+void Profiler::Arm( )
+{
+	lua_Hook hook = lua_gethook( main_state );
+	if( hook == Hook )
+		return;
+
+	previous_hook = hook;
+	previous_mask = lua_gethookmask( main_state );
+	previous_count = lua_gethookcount( main_state );
+	lua_sethook( main_state, Hook, LUA_MASKCOUNT, 1 );
+}
+
+void Profiler::Disarm( lua_State *state )
+{
+	if( lua_gethook( state ) == Hook )
+		lua_sethook( state, previous_hook, previous_mask, previous_count );
+}
+
+// Appends the name of a stack frame, in a form flamegraph tools can parse
+static void AppendFrame( std::string &frame, const lua_Debug &debug )
+{
+	if( debug.name != nullptr )
+		frame += debug.name;
+	else if( *debug.what == 'm' )
+		frame += "main chunk";
+	else
+		frame += '?';
+
+	frame += ' ';
+	if( *debug.what == 'C' )
+	{
+		frame += "[C]";
+	}
+	else
+	{
+		char line[16];
+		snprintf( line, sizeof( line ), ":%d", debug.linedefined );
+		frame += debug.short_src;
+		frame += line;
+	}
+
+	for( size_t k = 0; k < frame.size( ); ++k )
+		if( frame[k] == ';' || frame[k] == '\n' )
+			frame[k] = '_';
+}
+
+void Profiler::Sample( lua_State *state )
+{
+	try
+	{
+		lua_Debug debug;
+		int depth = 0;
+		for( ; depth < MaxStackDepth && lua_getstack( state, depth, &debug ) != 0; ++depth )
+		{
+			lua_getinfo( state, "Sn", &debug );
+			if( frames.size( ) <= static_cast<size_t>( depth ) )
+				frames.resize( depth + 1 );
+
+			frames[depth].clear( );
+			AppendFrame( frames[depth], debug );
+		}
+
+		if( depth == 0 )
+			return;
+
+		// Folded stacks go from the outermost frame to the innermost one
+		stack.clear( );
+		for( int k = depth - 1; k >= 0; --k )
+		{
+			stack += frames[k];
+			if( k != 0 )
+				stack += ';';
+		}
+
+		++stacks[stack];
+	}
+	catch( const std::bad_alloc & )
+	{
+		// Dropping a sample is better than raising an error from a hook
+	}
+}
+
+#if defined __linux__
+
+// Runs on the thread running the Lua state, where arming the hook is safe,
+// like the interrupt handler of the standalone interpreter does
+void Profiler::Signal( int signum, siginfo_t *info, void *context )
+{
+	int slot = info->si_code == SI_TIMER ? info->si_value.sival_int : -1;
+	Profiler *profiler = slot >= 0 && slot < MaxSignalSlots ? signal_profilers[slot].load( ) : nullptr;
+	if( profiler != nullptr )
+	{
+		profiler->Arm( );
+		return;
+	}
+
+	// Not sent by a profiler, pass it on to the handler it replaced
+	if( ( signal_previous.sa_flags & SA_SIGINFO ) != 0 )
+		signal_previous.sa_sigaction( signum, info, context );
+	else if( signal_previous.sa_handler != SIG_DFL && signal_previous.sa_handler != SIG_IGN )
+		signal_previous.sa_handler( signum );
+}
+
+// Samples through a timer signaling the thread calling Start (the handler
+// stays installed afterwards, since signals might still be pending)
+bool Profiler::StartSignal( )
+{
+	std::lock_guard<std::mutex> lock( signal_mutex );
+	int slot = 0;
+	while( slot < MaxSignalSlots && signal_profilers[slot].load( ) != nullptr )
+		++slot;
+
+	if( slot == MaxSignalSlots )
+		return false;
+
+	if( !signal_installed )
+	{
+		struct sigaction action;
+		memset( &action, 0, sizeof( action ) );
+		action.sa_sigaction = Signal;
+		action.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigemptyset( &action.sa_mask );
+		if( sigaction( SIGPROF, &action, &signal_previous ) != 0 )
+			return false;
+
+		signal_installed = true;
+	}
+
+	struct sigevent event;
+	memset( &event, 0, sizeof( event ) );
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGPROF;
+	event.sigev_value.sival_int = slot;
+	event.sigev_notify_thread_id = static_cast<pid_t>( syscall( SYS_gettid ) );
+	if( timer_create( CLOCK_MONOTONIC, &event, &signal_timer ) != 0 )
+		return false;
+
+	signal_profilers[slot] = this;
+	signal_slot = slot;
+
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = static_cast<time_t>( interval.count( ) / 1000000 );
+	spec.it_interval.tv_nsec = static_cast<long>( interval.count( ) % 1000000 * 1000 );
+	spec.it_value = spec.it_interval;
+	if( timer_settime( signal_timer, 0, &spec, nullptr ) != 0 )
+	{
+		signal_profilers[slot] = nullptr;
+		signal_slot = -1;
+		timer_delete( signal_timer );
+		return false;
+	}
+
+	return true;
+}
+
+void Profiler::StopSignal( )
+{
+	std::lock_guard<std::mutex> lock( signal_mutex );
+	signal_profilers[signal_slot] = nullptr;
+	timer_delete( signal_timer );
+	signal_slot = -1;
+}
+
+#endif
+
+// Fallback where no timer can signal the thread running the Lua state:
+// lua_sethook is called from the timer thread while the VM runs, which is
+// a data race on the hook fields of the state (tolerated, at worst a
+// sample is lost or delayed, but not guaranteed by the language)
+void Profiler::Tick( )
+{
+	typedef std::chrono::steady_clock clock;
+
+	// Deadlines are kept absolute, so the sampling rate doesn't drift with wake up latency
+	clock::time_point deadline = clock::now( );
+	std::unique_lock<std::mutex> lock( timer_mutex );
+	while( running )
+	{
+		deadline += interval;
+		// The VM only pays for the hook when a sample is due
+		if( !timer_stopped.wait_until( lock, deadline, [this]( ) { return !running; } ) )
+			Arm( );
+	}
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Lua/Config.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined __linux__
+
+#include <signal.h>
+#include <time.h>
+
+#endif
+
+struct lua_Debug;
+
+namespace Lua
+{
+
+class Profiler
+{
+public:
+	Profiler( );
+	~Profiler( );
+
+	void Start( lua_State *state, unsigned int frequency );
+	void Stop( );
+
+	void Clear( );
+	bool Dump( FILE *file ) const;
+	void Push( lua_State *state ) const;
+
+private:
+	Profiler( const Profiler & );
+	Profiler &operator=( const Profiler & );
+
+	typedef void ( *HookFunction )( lua_State *state, lua_Debug *debug );
+
+	static void Hook( lua_State *state, lua_Debug *debug );
+
+	void Arm( );
+	void Disarm( lua_State *state );
+
+#if defined __linux__
+
+	static void Signal( int signum, siginfo_t *info, void *context );
+
+	bool StartSignal( );
+	void StopSignal( );
+
+#endif
+
+	void Sample( lua_State *state );
+	void Tick( );
+
+	lua_State *main_state;
+	std::atomic<bool> running;
+	std::atomic<HookFunction> previous_hook;
+	std::atomic<int> previous_mask;
+	std::atomic<int> previous_count;
+	std::chrono::microseconds interval;
+	std::thread timer;
+	std::mutex timer_mutex;
+	std::condition_variable timer_stopped;
+
+#if defined __linux__
+
+	timer_t signal_timer;
+	int signal_slot;
+
+#endif
+
+	std::unordered_map<std::string, size_t> stacks;
+	std::vector<std::string> frames;
+	std::string stack;
+};
+
+}
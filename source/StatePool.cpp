@@ -0,0 +1,534 @@
+#include <lua.hpp>
+#include <Lua/StatePool.hpp>
+#include <Lua/Interface.hpp>
+#include <Internal.hpp>
+#include <thread>
+
+namespace Lua
+{
+
+enum SnapshotField
+{
+	SnapshotRegistry = 1,
+	SnapshotGlobals,
+	SnapshotGlobalsMetaTable,
+	SnapshotLoaded,
+	SnapshotLibraries,
+	SnapshotMetaTables
+};
+
+// Fields of the snapshot of the metatable shared by a basic type
+enum MetaTableField
+{
+	MetaTable = 1,
+	MetaTableCopy,
+	MetaTableIndex,
+	MetaTableIndexCopy
+};
+
+// Types whose values share a metatable, set through debug.setmetatable
+static const int BasicTypes[] = {
+	LUA_TNIL,
+	LUA_TBOOLEAN,
+	LUA_TLIGHTUSERDATA,
+	LUA_TNUMBER,
+	LUA_TSTRING,
+	LUA_TFUNCTION,
+	LUA_TTHREAD
+};
+
+// Collector and hook settings, which aren't kept in tables
+struct StateSettings
+{
+	bool collecting;
+	int pause;
+	int stepmul;
+	lua_Hook hook;
+	int hook_mask;
+	int hook_count;
+};
+
+struct StatePool::Entry
+{
+	Interface lua;
+	int snapshot;
+	int reference_table;
+	std::vector<Interface::TypeEntry> types;
+	StateSettings settings;
+};
+
+// lua_absindex isn't available on Lua 5.1, pseudo-indices aren't used here
+static int AbsIndex( lua_State *state, int index )
+{
+	return index < 0 ? lua_gettop( state ) + index + 1 : index;
+}
+
+// Pushes a shallow copy of the table at index
+static void CopyTable( lua_State *state, int index )
+{
+	index = AbsIndex( state, index );
+	lua_newtable( state );
+	lua_pushnil( state );
+	while( lua_next( state, index ) != 0 )
+	{
+		lua_pushvalue( state, -2 );
+		lua_insert( state, -2 );
+		lua_rawset( state, -4 );
+	}
+}
+
+// Makes the table at index a shallow copy of the table at copy, keeping its identity
+static void RestoreTable( lua_State *state, int index, int copy )
+{
+	index = AbsIndex( state, index );
+	copy = AbsIndex( state, copy );
+
+	// Clearing fields during a traversal is allowed, adding them isn't
+	lua_pushnil( state );
+	while( lua_next( state, index ) != 0 )
+	{
+		lua_pop( state, 1 );
+		lua_pushvalue( state, -1 );
+		lua_rawget( state, copy );
+		if( lua_isnil( state, -1 ) )
+		{
+			lua_pushvalue( state, -2 );
+			lua_pushnil( state );
+			lua_rawset( state, index );
+		}
+
+		lua_pop( state, 1 );
+	}
+
+	lua_pushnil( state );
+	while( lua_next( state, copy ) != 0 )
+	{
+		lua_pushvalue( state, -2 );
+		lua_insert( state, -2 );
+		lua_rawset( state, index );
+	}
+}
+
+static void PushLoaded( lua_State *state )
+{
+	lua_getfield( state, LUA_REGISTRYINDEX, "_LOADED" );
+}
+
+static int NoFunction( lua_State * )
+{
+	return 0;
+}
+
+// Pushes a value of a basic type, to get and set the metatable of the type
+static void PushBasicValue( lua_State *state, int type )
+{
+	switch( type )
+	{
+	case LUA_TNIL: lua_pushnil( state ); break;
+	case LUA_TBOOLEAN: lua_pushboolean( state, 0 ); break;
+	case LUA_TLIGHTUSERDATA: lua_pushlightuserdata( state, nullptr ); break;
+	case LUA_TNUMBER: lua_pushnumber( state, 0 ); break;
+	case LUA_TSTRING: lua_pushliteral( state, "" ); break;
+	case LUA_TFUNCTION: lua_pushcfunction( state, NoFunction ); break;
+	default: lua_pushthread( state ); break;
+	}
+}
+
+// Pushes a table with the metatables of the basic types, with copies of
+// them and of their __index tables (like the string library for strings)
+static void TakeMetaTables( lua_State *state )
+{
+	lua_newtable( state );
+	for( size_t k = 0; k < sizeof( BasicTypes ) / sizeof( *BasicTypes ); ++k )
+	{
+		PushBasicValue( state, BasicTypes[k] );
+		if( lua_getmetatable( state, -1 ) == 0 )
+		{
+			lua_pop( state, 1 );
+			continue;
+		}
+
+		lua_createtable( state, 4, 0 );
+		lua_pushvalue( state, -2 );
+		lua_rawseti( state, -2, MetaTable );
+		CopyTable( state, -2 );
+		lua_rawseti( state, -2, MetaTableCopy );
+
+		lua_pushliteral( state, "__index" );
+		lua_rawget( state, -3 );
+		if( lua_istable( state, -1 ) )
+		{
+			CopyTable( state, -1 );
+			lua_rawseti( state, -3, MetaTableIndexCopy );
+			lua_rawseti( state, -2, MetaTableIndex );
+		}
+		else
+		{
+			lua_pop( state, 1 );
+		}
+
+		lua_rawseti( state, -4, BasicTypes[k] );
+		lua_pop( state, 2 );
+	}
+}
+
+// Restores the metatables of the basic types from the table on top
+static void RestoreMetaTables( lua_State *state )
+{
+	for( size_t k = 0; k < sizeof( BasicTypes ) / sizeof( *BasicTypes ); ++k )
+	{
+		PushBasicValue( state, BasicTypes[k] );
+		lua_rawgeti( state, -2, BasicTypes[k] );
+		if( !lua_istable( state, -1 ) )
+		{
+			lua_setmetatable( state, -2 );
+			lua_pop( state, 1 );
+			continue;
+		}
+
+		lua_rawgeti( state, -1, MetaTable );
+		lua_rawgeti( state, -2, MetaTableCopy );
+		RestoreTable( state, -2, -1 );
+		lua_pop( state, 1 );
+
+		lua_rawgeti( state, -2, MetaTableIndex );
+		if( lua_istable( state, -1 ) )
+		{
+			lua_rawgeti( state, -3, MetaTableIndexCopy );
+			RestoreTable( state, -2, -1 );
+			lua_pop( state, 1 );
+		}
+
+		lua_pop( state, 1 );
+		lua_setmetatable( state, -3 );
+		lua_pop( state, 2 );
+	}
+}
+
+static void TakeSnapshot( Interface &lua, int &snapshot, StateSettings &settings )
+{
+	lua_State *state = lua.GetLuaState( );
+	lua_settop( state, 0 );
+
+	// The collector settings can only be read by replacing them
+	settings.collecting = Internal::IsCollectorRunning( state );
+	settings.pause = lua_gc( state, LUA_GCSETPAUSE, 100 );
+	lua_gc( state, LUA_GCSETPAUSE, settings.pause );
+	settings.stepmul = lua_gc( state, LUA_GCSETSTEPMUL, 200 );
+	lua_gc( state, LUA_GCSETSTEPMUL, settings.stepmul );
+
+	settings.hook = lua_gethook( state );
+	settings.hook_mask = lua_gethookmask( state );
+	settings.hook_count = lua_gethookcount( state );
+
+	// Referenced before copying the registry, so it's part of the snapshot
+	lua_createtable( state, 6, 0 );
+	lua_pushvalue( state, 1 );
+	snapshot = luaL_ref( state, LUA_REGISTRYINDEX );
+
+	lua_pushvalue( state, LUA_REGISTRYINDEX );
+	CopyTable( state, -1 );
+	lua_rawseti( state, 1, SnapshotRegistry );
+	lua_pop( state, 1 );
+
+	lua.PushGlobal( );
+	CopyTable( state, -1 );
+	lua_rawseti( state, 1, SnapshotGlobals );
+	if( lua_getmetatable( state, -1 ) != 0 )
+		lua_rawseti( state, 1, SnapshotGlobalsMetaTable );
+
+	lua_pop( state, 1 );
+
+	PushLoaded( state );
+	if( lua_istable( state, -1 ) )
+	{
+		CopyTable( state, -1 );
+		lua_rawseti( state, 1, SnapshotLoaded );
+
+		lua_newtable( state );
+		lua_pushnil( state );
+		while( lua_next( state, -3 ) != 0 )
+		{
+			if( lua_istable( state, -1 ) )
+			{
+				lua_pushvalue( state, -1 );
+				CopyTable( state, -1 );
+				lua_rawset( state, -5 );
+			}
+
+			lua_pop( state, 1 );
+		}
+
+		lua_rawseti( state, 1, SnapshotLibraries );
+	}
+
+	lua_pop( state, 1 );
+
+	TakeMetaTables( state );
+	lua_rawseti( state, 1, SnapshotMetaTables );
+
+	lua_settop( state, 0 );
+}
+
+static void RestoreSnapshot( Interface &lua, int snapshot, const StateSettings &settings )
+{
+	lua_State *state = lua.GetLuaState( );
+	lua_settop( state, 0 );
+
+	// Stops the profiler first, as it puts back the hook it replaced
+	lua.StopProfiler( );
+	lua.ClearProfile( );
+	lua_sethook( state, settings.hook, settings.hook_mask, settings.hook_count );
+
+	lua_rawgeti( state, LUA_REGISTRYINDEX, snapshot );
+
+	lua_pushvalue( state, LUA_REGISTRYINDEX );
+	lua_rawgeti( state, 1, SnapshotRegistry );
+	RestoreTable( state, -2, -1 );
+	lua_pop( state, 2 );
+
+	lua_rawgeti( state, 1, SnapshotLoaded );
+	if( lua_istable( state, -1 ) )
+	{
+		PushLoaded( state );
+		RestoreTable( state, -1, -2 );
+		lua_pop( state, 1 );
+
+		lua_rawgeti( state, 1, SnapshotLibraries );
+		lua_pushnil( state );
+		while( lua_next( state, -2 ) != 0 )
+		{
+			RestoreTable( state, -2, -1 );
+			lua_pop( state, 1 );
+		}
+
+		lua_pop( state, 1 );
+	}
+
+	lua_pop( state, 1 );
+
+	lua.PushGlobal( );
+	lua_rawgeti( state, 1, SnapshotGlobals );
+	RestoreTable( state, -2, -1 );
+	lua_pop( state, 1 );
+	lua_rawgeti( state, 1, SnapshotGlobalsMetaTable );
+	lua_setmetatable( state, -2 );
+	lua_pop( state, 1 );
+
+	lua_rawgeti( state, 1, SnapshotMetaTables );
+	RestoreMetaTables( state );
+
+	lua_settop( state, 0 );
+
+	lua_gc( state, LUA_GCSETPAUSE, settings.pause );
+	lua_gc( state, LUA_GCSETSTEPMUL, settings.stepmul );
+	lua_gc( state, settings.collecting ? LUA_GCRESTART : LUA_GCSTOP, 0 );
+}
+
+StatePool::Handle::Handle( ) :
+	pool( nullptr ),
+	entry( nullptr )
+{ }
+
+StatePool::Handle::Handle( StatePool *pool, Entry *entry ) :
+	pool( pool ),
+	entry( entry )
+{ }
+
+StatePool::Handle::Handle( Handle &&handle ) :
+	pool( handle.pool ),
+	entry( handle.entry )
+{
+	handle.pool = nullptr;
+	handle.entry = nullptr;
+}
+
+StatePool::Handle::~Handle( )
+{
+	Release( );
+}
+
+StatePool::Handle &StatePool::Handle::operator=( Handle &&handle )
+{
+	if( this != &handle )
+	{
+		Release( );
+		pool = handle.pool;
+		entry = handle.entry;
+		handle.pool = nullptr;
+		handle.entry = nullptr;
+	}
+
+	return *this;
+}
+
+Interface *StatePool::Handle::Get( ) const
+{
+	return entry != nullptr ? &entry->lua : nullptr;
+}
+
+Interface &StatePool::Handle::operator*( ) const
+{
+	return entry->lua;
+}
+
+Interface *StatePool::Handle::operator->( ) const
+{
+	return &entry->lua;
+}
+
+void StatePool::Handle::Release( )
+{
+	if( entry != nullptr )
+	{
+		pool->Release( entry );
+		pool = nullptr;
+		entry = nullptr;
+	}
+}
+
+StatePool::StatePool( size_t count, Bootstrap bootstrap ) :
+	bootstrap( bootstrap ),
+	shard_count( std::thread::hardware_concurrency( ) )
+{
+	if( shard_count == 0 )
+		shard_count = 1;
+
+	shards.reset( new Shard[shard_count] );
+
+	try
+	{
+		for( size_t k = 0; k < count; ++k )
+		{
+			Entry *entry = Create( );
+			Shard &shard = shards[k % shard_count];
+			try
+			{
+				shard.idle.push_back( entry );
+			}
+			catch( ... )
+			{
+				delete entry;
+				throw;
+			}
+		}
+	}
+	catch( ... )
+	{
+		// The destructor doesn't run when the constructor throws
+		for( size_t k = 0; k < shard_count; ++k )
+			for( size_t i = 0; i < shards[k].idle.size( ); ++i )
+				delete shards[k].idle[i];
+
+		throw;
+	}
+}
+
+StatePool::~StatePool( )
+{
+	for( size_t k = 0; k < shard_count; ++k )
+		for( size_t i = 0; i < shards[k].idle.size( ); ++i )
+			delete shards[k].idle[i];
+}
+
+StatePool::Handle StatePool::Acquire( )
+{
+	Entry *entry = nullptr;
+
+	{
+		Shard &shard = GetShard( );
+		std::lock_guard<std::mutex> lock( shard.mutex );
+		if( !shard.idle.empty( ) )
+		{
+			entry = shard.idle.back( );
+			shard.idle.pop_back( );
+		}
+	}
+
+	// Steal from the other shards before creating a new state
+	for( size_t k = 0; entry == nullptr && k < shard_count; ++k )
+	{
+		Shard &shard = shards[k];
+		std::unique_lock<std::mutex> lock( shard.mutex, std::try_to_lock );
+		if( lock.owns_lock( ) && !shard.idle.empty( ) )
+		{
+			entry = shard.idle.back( );
+			shard.idle.pop_back( );
+		}
+	}
+
+	if( entry == nullptr )
+		entry = Create( );
+
+	entry->lua.SetOwnerThread( );
+	return Handle( this, entry );
+}
+
+size_t StatePool::GetIdleCount( ) const
+{
+	size_t count = 0;
+	for( size_t k = 0; k < shard_count; ++k )
+	{
+		std::lock_guard<std::mutex> lock( shards[k].mutex );
+		count += shards[k].idle.size( );
+	}
+
+	return count;
+}
+
+StatePool::Entry *StatePool::Create( )
+{
+	std::unique_ptr<Entry> entry( new Entry );
+	if( bootstrap )
+		bootstrap( entry->lua );
+
+	Interface &lua = entry->lua;
+	lua.FlushReferences( );
+	TakeSnapshot( lua, entry->snapshot, entry->settings );
+	entry->reference_table = lua.reference_table;
+	entry->types = lua.types;
+	return entry.release( );
+}
+
+void StatePool::Release( Entry *entry )
+{
+	Interface &lua = entry->lua;
+
+	// Objects still alive would be left pointing at released references
+	lua.FlushReferences( );
+	if( lua.object_count != 0 )
+	{
+		delete entry;
+		return;
+	}
+
+	try
+	{
+		RestoreSnapshot( lua, entry->snapshot, entry->settings );
+		lua.reference_table = entry->reference_table;
+		lua.types = entry->types;
+	}
+	catch( ... )
+	{
+		delete entry;
+		return;
+	}
+
+	Shard &shard = GetShard( );
+	std::lock_guard<std::mutex> lock( shard.mutex );
+	try
+	{
+		shard.idle.push_back( entry );
+	}
+	catch( ... )
+	{
+		delete entry;
+	}
+}
+
+StatePool::Shard &StatePool::GetShard( )
+{
+	return shards[std::hash<std::thread::id>( )( std::this_thread::get_id( ) ) % shard_count];
+}
+
+}
@@ -0,0 +1,154 @@
+#include <lua.hpp>
+#include <Lua/StringBuilder.hpp>
+#include <Lua/Interface.hpp>
+#include <string.h>
+
+#if defined _WIN32
+
+#define snprintf _snprintf
+
+#endif
+
+namespace Lua
+{
+
+// Enough for any number formatted with LUA_NUMBER_FMT or an integer
+static const size_t NumberSize = 64;
+
+StringBuilder::StringBuilder( Interface &lua ) :
+	lua( lua ),
+	data( storage ),
+	size( 0 ),
+	capacity( sizeof( storage ) ),
+	box( 0 )
+{ }
+
+void StringBuilder::Grow( size_t needed )
+{
+	size_t newcapacity = capacity * 2;
+	if( newcapacity - size < needed )
+		newcapacity = size + needed;
+
+	char *newdata = static_cast<char *>( lua.NewUserdata( newcapacity ) );
+	memcpy( newdata, data, size );
+
+	if( box != 0 )
+		lua.Replace( box );
+	else
+		box = lua.GetTop( );
+
+	data = newdata;
+	capacity = newcapacity;
+}
+
+void StringBuilder::Reserve( size_t needed )
+{
+	if( capacity - size < needed )
+		Grow( needed );
+}
+
+char *StringBuilder::Prepare( size_t needed )
+{
+	Reserve( needed );
+	return data + size;
+}
+
+void StringBuilder::Commit( size_t added )
+{
+	size += added;
+}
+
+void StringBuilder::AddString( const char *str, size_t len )
+{
+	memcpy( Prepare( len ), str, len );
+	size += len;
+}
+
+void StringBuilder::AddString( const char *str )
+{
+	AddString( str, strlen( str ) );
+}
+
+void StringBuilder::AddChar( char ch )
+{
+	*Prepare( 1 ) = ch;
+	++size;
+}
+
+void StringBuilder::AddNumber( double number )
+{
+	char *dest = Prepare( NumberSize );
+	int written = snprintf( dest, NumberSize, LUA_NUMBER_FMT, number );
+	if( written <= 0 )
+		return;
+
+#if LUA_VERSION_NUM >= 503
+
+	// Lua 5.3 tells floats apart from integers with a trailing ".0"
+	if( dest[strspn( dest, "-0123456789" )] == '\0' && written + 2 < static_cast<int>( NumberSize ) )
+	{
+		dest[written++] = '.';
+		dest[written++] = '0';
+	}
+
+#endif
+
+	size += static_cast<size_t>( written );
+}
+
+void StringBuilder::AddInteger( long long number )
+{
+	int written = snprintf( Prepare( NumberSize ), NumberSize, "%lld", number );
+	if( written > 0 )
+		size += static_cast<size_t>( written );
+}
+
+void StringBuilder::AddValue( )
+{
+	size_t len = 0;
+	if( lua.ToString( -1, &len ) != nullptr )
+	{
+		if( capacity - size < len )
+		{
+			bool spilling = box == 0;
+			Grow( len );
+			if( spilling )
+			{
+				// The new box was pushed above the value, swap them
+				lua.Insert( -2 );
+				box = lua.GetTop( ) - 1;
+			}
+		}
+
+		const char *str = lua.ToString( -1, &len );
+		memcpy( data + size, str, len );
+		size += len;
+	}
+
+	lua.Pop( 1 );
+}
+
+size_t StringBuilder::Size( ) const
+{
+	return size;
+}
+
+const char *StringBuilder::Data( ) const
+{
+	return data;
+}
+
+const char *StringBuilder::Finish( size_t *outlen )
+{
+	lua.PushString( data, size );
+	if( box != 0 )
+		lua.Remove( box );
+
+	data = storage;
+	size = 0;
+	capacity = sizeof( storage );
+	box = 0;
+	return lua.ToString( -1, outlen );
+}
+
+}
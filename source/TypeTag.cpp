@@ -0,0 +1,24 @@
+#include <Lua/TypeTag.hpp>
+#include <atomic>
+
+namespace Lua
+{
+
+static std::atomic<size_t> next_id( 0 );
+
+TypeTag::TypeTag( const char *name ) :
+	name( name ),
+	id( next_id++ )
+{ }
+
+const char *TypeTag::GetName( ) const
+{
+	return name;
+}
+
+size_t TypeTag::GetID( ) const
+{
+	return id;
+}
+
+}